@@ -1,187 +1,32 @@
 #pragma once
 
-#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <source_location>
-#include <variant>
+#include <mutex>
 #include <optional>
 #include <type_traits>
-#include <queue>
+#include <unordered_map>
 #include <chrono>
-#include <map>
-#include <thread>
+#include <exception>
+#include <expected>
+#include <memory>
+#include <utility>
 
-#include "ucontext.h"
+#include "blocking.hpp"
+#include "coroutine.hpp"
+#include "stack.hpp"
+#include "timer.hpp"
+#include "util.hpp"
 
 namespace AIO {
 
     namespace _impl {
 
-        static constexpr size_t COROUTINE_STACK_SIZE_BYTES = 16 * 1024;
-
-        inline thread_local void *volatile current_coroutine = nullptr;
-
-
-        [[noreturn]] inline void assertion_failed(const std::string &what,
-                                                  const std::source_location where = std::source_location::current()) {
-            std::cerr << std::string(where.file_name()) + ":" + std::to_string(where.line()) + ":" +
-                         std::to_string(where.column()) + ": function ‘" + where.function_name() +
-                         "’: assertion failed: " + what << std::endl;
-            std::abort();
-        }
-
-        struct coroutine_finish {
-        };
-
         struct coroutine_void_t {
         };
 
-        template<typename Signature>
-        class CoroutineCore;
-
-        struct coroutine_kill {
-        private:
-            bool handled = false;
-
-            template<typename Signature>
-            friend
-            class CoroutineCore;
-
-        public:
-            ~coroutine_kill() noexcept(false) {
-                if (!handled) throw coroutine_kill(); // NOLINT(*-exception-baseclass)
-            }
-        };
-
-        template<typename Ret, typename Arg>
-        class CoroutineCore<Ret(Arg)> {
-        protected:
-            ucontext_t context{}, ret_context{};
-            std::optional<std::tuple<Arg &>> arg_ref = std::nullopt;
-            std::optional<std::tuple<Ret &>> ret_ref = std::nullopt;
-            std::vector<char> stack{};
-
-            bool dead = false;
-
-        public:
-            explicit CoroutineCore(void (*entrypoint)()) : stack(COROUTINE_STACK_SIZE_BYTES) {
-                getcontext(&context);
-                context.uc_link = nullptr;
-                context.uc_stack.ss_sp = stack.data();
-                context.uc_stack.ss_size = COROUTINE_STACK_SIZE_BYTES;
-                makecontext(&context, entrypoint, 0);
-            }
-
-            CoroutineCore(CoroutineCore &&other) noexcept: CoroutineCore(nullptr) {
-                this->swap(other);
-            }
-
-            CoroutineCore &operator=(CoroutineCore &&other) noexcept {
-                if (&other == this) return *this;
-                CoroutineCore junk;
-                this->swap(junk);
-                this->swap(other);
-                return *this;
-            }
-
-            CoroutineCore &operator=(const CoroutineCore &coroutine) = delete;
-
-            ~CoroutineCore() {
-                if (!context.uc_link) return;
-                if (!dead) kill();
-                swapcontext(&ret_context, &context);
-            }
-
-            void swap(CoroutineCore &other) noexcept {
-                std::swap(context, other.context);
-                std::swap(ret_context, other.ret_context);
-                std::swap(arg_ref, other.arg_ref);
-                std::swap(ret_ref, other.ret_ref);
-                std::swap(stack, other.stack);
-                std::swap(dead, other.dead);
-            }
-
-            bool is_dead() const { return dead; }
-
-            void kill() {
-                if (dead) assertion_failed("attempt to kill dead coroutine");
-                if (current_coroutine == this) throw coroutine_kill(); // NOLINT(*-exception-baseclass)
-                void *prev_coroutine = current_coroutine;
-                current_coroutine = this;
-                swapcontext(&ret_context, &context);
-                current_coroutine = prev_coroutine;
-                try {
-                    throw;
-                } catch (coroutine_kill &kill) {
-                    kill.handled = true;
-                }
-            }
-
-            template<typename ResumeArg>
-            Ret resume_impl(ResumeArg &&arg) {
-                if (current_coroutine == this) assertion_failed("attempt to resume current coroutine");
-                if (dead) assertion_failed("attempt to resume dead coroutine");
-                arg_ref = std::tuple<Arg &>(const_cast<Arg &>(arg));
-                void *prev_coroutine = current_coroutine;
-                current_coroutine = this;
-                swapcontext(&ret_context, &context);
-                current_coroutine = prev_coroutine;
-                if (!ret_ref.has_value()) {
-                    throw;
-                }
-                auto &ret = std::get<0>(ret_ref.value());
-                ret_ref.reset();
-                return ret;
-            }
-
-            template<typename YieldRet>
-            Arg yield_impl(YieldRet &&ret, bool finish = false) {
-                if (current_coroutine != this) assertion_failed("attempt to yield another coroutine");
-                ret_ref = std::tuple<Ret &>(const_cast<Ret &>(ret));
-                if (finish) dead = true;
-                swapcontext(&context, &ret_context);
-                if (finish) throw coroutine_finish(); // NOLINT(*-exception-baseclass)
-                if (!arg_ref.has_value()) kill();
-                auto &arg = std::get<0>(arg_ref.value());
-                arg_ref.reset();
-                return arg;
-            }
-
-            void yield_err() {
-                dead = true;
-                swapcontext(&context, &ret_context);
-                throw coroutine_finish(); // NOLINT(*-exception-baseclass)
-            }
-        };
-
-        template<typename Signature, typename Derived>
-        class CoroutineBase;
-
-        template<typename Ret, typename Arg, typename Derived>
-        class CoroutineBase<Ret(Arg), Derived> : public CoroutineCore<Ret(Arg)> {
-        public:
-            CoroutineBase() : CoroutineCore<Ret(Arg)>(entrypoint) {}
-
-        private:
-            void start() {
-                try {
-                    auto &arg = std::get<0>(CoroutineCore<Ret(Arg)>::arg_ref.value());
-                    CoroutineCore<Ret(Arg)>::arg_ref.reset();
-                    CoroutineCore<Ret(Arg)>::yield_impl((*static_cast<Derived *>(this))(arg), true);
-                } catch (coroutine_finish) {
-                } catch (...) {
-                    try {
-                        CoroutineCore<Ret(Arg)>::yield_err();
-                    } catch (coroutine_finish) {}
-                }
-                swapcontext(&(CoroutineCore<Ret(Arg)>::context), &(CoroutineCore<Ret(Arg)>::ret_context));
-            }
-
-            static void entrypoint() {
-                static_cast<CoroutineBase *>(current_coroutine)->start();
-            }
-        };
-
         class Bond {
             std::optional<Bond *> link;
 
@@ -229,145 +74,134 @@ namespace AIO {
                 return link.value();
             }
         };
-    }
 
-    class EventLoop;
-
-    template<typename Signature>
-    class Coroutine {
-    };
-
-    template<typename Ret, typename Arg>
-    class Coroutine<Ret(Arg)> : _impl::CoroutineBase<Ret(Arg), Coroutine<Ret(Arg)>>, std::move_only_function<Ret(Arg)> {
-        friend _impl::CoroutineBase<Ret(Arg), Coroutine>;
-    public:
-        template<typename Functor, typename FunctorDec = std::decay_t<Functor>>
-        requires (!std::is_same_v<FunctorDec, Coroutine>)
-        Coroutine(Functor &&start_fn) : // NOLINT(*-explicit-constructor, *-forwarding-reference-overload)
-                std::move_only_function<Ret(Arg)>([start_fn = std::forward<Functor>(start_fn)](auto arg) {
-                    return start_fn(arg);
-                }) {}
+        // Hand-off between the producer resolving a future and the consumer suspending on it, which may run on
+        // different threads: the consumer parks only once it has switched out, and whichever side comes second
+        // wakes it up.
+        class Rendezvous {
+            enum : std::uint8_t {
+                PENDING, PARKED, RESOLVED
+            };
 
+            std::atomic<std::uint8_t> state = PENDING;
 
-        template<typename ResumeArg>
-        Ret resume(ResumeArg &&arg) {
-            return resume_impl(arg);
-        }
+        public:
+            Rendezvous() = default;
 
-        template<typename YieldRet>
-        Arg yield(YieldRet &&ret) {
-            return yield_impl(ret);
-        }
+            Rendezvous(Rendezvous &&other) noexcept: state(other.state.load(std::memory_order_relaxed)) {}
 
-        using _impl::CoroutineBase<Ret(Arg), Coroutine>::is_dead;
-        using _impl::CoroutineBase<Ret(Arg), Coroutine>::kill;
+            Rendezvous &operator=(Rendezvous &&other) noexcept {
+                state.store(other.state.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                return *this;
+            }
 
-    };
+            // Returns true if the consumer has parked and must be woken up by the producer
+            bool resolve() {
+                return state.exchange(RESOLVED, std::memory_order_acq_rel) == PARKED;
+            }
 
-    template<typename Ret>
-    class Coroutine<Ret()> : _impl::CoroutineBase<Ret(_impl::coroutine_void_t), Coroutine<Ret()>>,
-                             std::move_only_function<Ret(_impl::coroutine_void_t)> {
-        friend _impl::CoroutineBase<Ret(_impl::coroutine_void_t), Coroutine>;
-    public:
-        template<typename Functor, typename FunctorDec = std::decay_t<Functor>>
-        requires (!std::is_same_v<FunctorDec, Coroutine>)
-        Coroutine(Functor &&start_fn) : // NOLINT(*-explicit-constructor, *-forwarding-reference-overload)
-                std::move_only_function<Ret(_impl::coroutine_void_t)>(
-                        [start_fn = std::forward<Functor>(start_fn)](_impl::coroutine_void_t) {
-                            return start_fn();
-                        }) {}
+            // Returns false if the future got resolved meanwhile, so the consumer must not wait for a wake-up
+            bool park() {
+                std::uint8_t expected = PENDING;
+                return state.compare_exchange_strong(expected, PARKED, std::memory_order_acq_rel);
+            }
 
+            [[nodiscard]] bool is_resolved() const {
+                return state.load(std::memory_order_acquire) == RESOLVED;
+            }
+        };
 
-        Ret resume() {
-            return _impl::CoroutineBase<Ret(_impl::coroutine_void_t), Coroutine>::resume_impl(
-                    _impl::coroutine_void_t{});
-        }
+        // Result of a call made away from the loop that awaits it: the value, or the exception the call threw
+        template<typename Ret>
+        using Outcome = std::expected<Ret, std::exception_ptr>;
 
-        template<typename YieldRet>
-        void yield(YieldRet &&ret) {
-            _impl::CoroutineBase<Ret(_impl::coroutine_void_t), Coroutine>::yield_impl(ret);
+        template<typename Functor, typename... Args>
+        Outcome<std::invoke_result_t<Functor &, Args...>> capture(Functor &fn, Args &&... args) {
+            try {
+                return std::invoke(fn, std::forward<Args>(args)...);
+            } catch (...) {
+                return std::unexpected(std::current_exception());
+            }
         }
 
-        using _impl::CoroutineBase<Ret(_impl::coroutine_void_t), Coroutine>::is_dead;
-        using _impl::CoroutineBase<Ret(_impl::coroutine_void_t), Coroutine>::kill;
-    };
-
-    template<typename Arg>
-    class Coroutine<void(Arg)> : _impl::CoroutineBase<_impl::coroutine_void_t(Arg), Coroutine<void(Arg)>>,
-                                 std::move_only_function<_impl::coroutine_void_t(Arg)> {
-        friend _impl::CoroutineBase<_impl::coroutine_void_t(Arg), Coroutine>;
-    public:
-        template<typename Functor, typename FunctorDec = std::decay_t<Functor>>
-        requires (!std::is_same_v<FunctorDec, Coroutine>)
-        Coroutine(Functor &&start_fn) : // NOLINT(*-explicit-constructor, *-forwarding-reference-overload)
-                std::move_only_function<_impl::coroutine_void_t(Arg)>(
-                        [start_fn = std::forward<Functor>(start_fn)](auto arg) -> _impl::coroutine_void_t {
-                            start_fn(arg);
-                            return {};
-                        }) {}
+        // Coroutine kept right in its owner, so that it costs no allocation besides its stack. The owner must not
+        // move while the coroutine runs; moving it afterwards releases the finished coroutine instead of moving it.
+        class InplaceCoroutine {
+            std::optional<Coroutine<void()>> cor;
 
-        template<typename ResumeArg>
-        void resume(ResumeArg &&arg) {
-            _impl::CoroutineBase<_impl::coroutine_void_t(Arg), Coroutine>::resume_impl(arg);
-        }
+        public:
+            InplaceCoroutine() = default;
 
-        Arg yield() {
-            return _impl::CoroutineBase<_impl::coroutine_void_t(Arg), Coroutine>::yield_impl(_impl::coroutine_void_t{});
-        }
+            InplaceCoroutine(InplaceCoroutine &&other) noexcept {
+                other.reset();
+            }
 
-        using _impl::CoroutineBase<_impl::coroutine_void_t(Arg), Coroutine>::is_dead;
-        using _impl::CoroutineBase<_impl::coroutine_void_t(Arg), Coroutine>::kill;
-    };
+            InplaceCoroutine &operator=(InplaceCoroutine &&other) noexcept {
+                reset();
+                other.reset();
+                return *this;
+            }
 
-    template<>
-    class Coroutine<void()> : _impl::CoroutineBase<_impl::coroutine_void_t(_impl::coroutine_void_t), Coroutine<void()>>,
-                              std::move_only_function<_impl::coroutine_void_t(_impl::coroutine_void_t)> {
-        friend CoroutineBase;
-        friend EventLoop;
-    public:
-        template<typename Functor, typename FunctorDec = std::decay_t<Functor>>
-        requires (!std::is_same_v<FunctorDec, Coroutine>)
-        Coroutine(Functor &&start_fn) : // NOLINT(*-explicit-constructor, *-forwarding-reference-overload)
-                std::move_only_function<_impl::coroutine_void_t(_impl::coroutine_void_t)>(
-                        [start_fn = std::forward<Functor>(start_fn)](
-                                _impl::coroutine_void_t) -> _impl::coroutine_void_t {
-                            start_fn();
-                            return {};
-                        }) {}
+            template<typename Functor>
+            Coroutine<void()> &emplace(Functor &&fn, StackAllocator &allocator) {
+                return cor.emplace(std::forward<Functor>(fn), allocator);
+            }
 
-        void resume() {
-            resume_impl(_impl::coroutine_void_t{});
-        }
+            void reset() {
+                if (cor.has_value() && !cor->is_dead())
+                    assertion_failed("coroutine moved while it runs");
+                cor.reset();
+            }
+        };
+    }
 
-        void yield() {
-            yield_impl(_impl::coroutine_void_t{});
-        }
+    class EventLoop;
 
-        using CoroutineBase::is_dead;
-        using CoroutineBase::kill;
+    template<typename Ret>
+    class Promise;
 
+    // Tag for EventLoop::async_call() and async(): the function computes its result without ever awaiting
+    struct NeverAwaits {
+        explicit NeverAwaits() = default;
     };
 
-    template<typename Ret>
-    class Promise;
+    inline constexpr NeverAwaits NEVER_AWAITS { };
 
     template<typename Ret>
-    class Future final
-            : _impl::Bond, _impl::CoroutineBase<_impl::coroutine_void_t(_impl::coroutine_void_t), Future<Ret>> {
+    class Future final : _impl::Bond {
         friend EventLoop;
         friend Promise<Ret>;
-        friend _impl::CoroutineBase<_impl::coroutine_void_t(_impl::coroutine_void_t), Future<Ret>>;
+
+        // Resumes the coroutine awaiting the future; the future cannot move while it is awaited, so the node is
+        // scheduled in place
+        struct Continuation final : _impl::TaskNode {
+            EventLoop *loop = nullptr;
+            Coroutine<void()> *cor = nullptr;
+        };
 
         EventLoop *loop;
         std::optional<Ret> ret;
+        std::exception_ptr error;
         std::move_only_function<Ret()> fn;
-        std::optional<std::move_only_function<void()>> cons;
+        Continuation cons;
         std::optional<_impl::coroutine_void_t> valid;
+        _impl::InplaceCoroutine cor;
+        _impl::Rendezvous rendezvous;
 
         template<typename Functor>
-        explicit Future(EventLoop *loop, Functor &&fn) : valid({}), loop(loop), fn(std::forward<Functor>(fn)) {}
+        explicit Future(EventLoop *loop, Functor &&fn) : loop(loop), fn(std::forward<Functor>(fn)), valid({}) {}
+
+        void resolve();
+
+        void resolve(Ret value);
 
-        _impl::coroutine_void_t operator()(_impl::coroutine_void_t);
+        void reject(std::exception_ptr exception);
+
+        void notify();
+
+        void run();
+
+        static void resume_consumer(_impl::TaskNode *task);
 
     public:
         using ReturnType = Ret;
@@ -376,13 +210,14 @@ namespace AIO {
 
         Future &operator=(Future &&) = default;
 
+        // Rethrows the exception the future was rejected with, if any
         Ret await();
 
         template<typename AsyncFunctor>
         Future<typename std::result_of_t<AsyncFunctor(Ret)>::ReturnType> then(AsyncFunctor &&async_fn);
 
         ~Future() override {
-            if (valid.has_value() && !cons.has_value()) _impl::assertion_failed("future was never awaited");
+            if (valid.has_value() && !cons.cor) assertion_failed("future was never awaited");
         }
     };
 
@@ -404,22 +239,148 @@ namespace AIO {
         class Future;
 
     protected:
-        using FutureCoroutine = _impl::CoroutineCore<_impl::coroutine_void_t(_impl::coroutine_void_t)>;
+        using FutureCoroutine = Coroutine<void()>;
+
+        [[nodiscard]] virtual StackAllocator &get_stack_allocator() = 0;
 
         virtual void set_current_coroutine(FutureCoroutine *cor) = 0;
 
         [[nodiscard]] virtual FutureCoroutine *get_current_coroutine() const = 0;
 
-        virtual void
-        add_task(std::move_only_function<void()> fn, std::chrono::time_point<std::chrono::system_clock> when) = 0;
+        virtual void add_task(std::move_only_function<void()> fn, Clock::time_point when) = 0;
+
+        virtual void add_task(std::move_only_function<void()> fn) = 0;
+
+        // Schedules an intrusive task, which must stay in place until it has run; loops without an intrusive ready
+        // queue run it from a function
+        virtual void add_task(_impl::TaskNode *task) {
+            add_task([task]() -> void {
+                task->run(task);
+            });
+        }
+
+        // Announces, on the loop's thread, a task that another thread is going to add with add_remote_task(); the
+        // loop keeps running until it arrives
+        virtual void expect_remote_task() = 0;
+
+        // Any thread; adds a task announced by expect_remote_task()
+        virtual void add_remote_task(std::move_only_function<void()> fn) = 0;
+
+        // Hands job to the pool. While the pool's queue is full, the loop keeps its calls in submission order and
+        // passes them on as the pool notifies it of room, so a saturated pool costs the loop no polling.
+        void submit_blocking(BlockingPool &pool, std::move_only_function<void()> job) {
+            if (backlogged.load(std::memory_order_acquire) == 0 && pool.try_submit(std::move(job)))
+                return;
+
+            std::lock_guard lock(backlog_mutex);
+            auto &backlog = backlogs[&pool];
+            if (backlog.empty() && pool.try_submit(std::move(job)))
+                return;
+            backlog.push_back(std::move(job));
+            backlogged.fetch_add(1, std::memory_order_relaxed);
+            if (backlog.size() == 1)
+                wait_for_room(pool);
+        }
+
+        // Queue of the calling thread that tasks may be built into directly; nullptr sends them through add_task()
+        [[nodiscard]] virtual _impl::TaskQueue *get_task_queue() {
+            return nullptr;
+        }
+
+        // add_task() that builds the function right in the loop's task arena when the loop has one
+        template<typename Functor>
+        void emplace_task(Functor &&fn) {
+            if (_impl::TaskQueue *queue = get_task_queue())
+                queue->post(std::forward<Functor>(fn));
+            else
+                add_task(std::move_only_function<void()>(std::forward<Functor>(fn)));
+        }
+
+        template<typename Functor>
+        void emplace_task(Functor &&fn, const Clock::time_point when) {
+            if (_impl::TaskQueue *queue = get_task_queue())
+                queue->schedule(std::forward<Functor>(fn), when);
+            else
+                add_task(std::move_only_function<void()>(std::forward<Functor>(fn)), when);
+        }
+
+        template<typename Ret>
+        static Promise<Ret> make_promise() {
+            return Promise<Ret>();
+        }
+
+        template<typename Ret, typename Functor>
+        Future<Ret> make_future(Promise<Ret> &promise, Functor &&fn) {
+            Future<Ret> future(this, std::forward<Functor>(fn));
+            _impl::Bond::bind(future, promise);
+            return future;
+        }
+
+        template<typename Ret>
+        Future<Ret> make_future(Promise<Ret> &promise) {
+            return make_future(promise, []() -> Ret { assertion_failed("externally resolved future was run"); });
+        }
+
+        template<typename Ret>
+        static void resolve(const Promise<Ret> &promise) {
+            promise.future().resolve();
+        }
+
+        template<typename Ret>
+        static void resolve(const Promise<Ret> &promise, Ret value) {
+            promise.future().resolve(std::move(value));
+        }
+
+        // The consumer's await() rethrows the exception
+        template<typename Ret>
+        static void reject(const Promise<Ret> &promise, std::exception_ptr exception) {
+            promise.future().reject(std::move(exception));
+        }
+
+        template<typename Ret>
+        static void settle(const Promise<Ret> &promise, _impl::Outcome<Ret> outcome) {
+            if (outcome.has_value())
+                resolve(promise, std::move(*outcome));
+            else
+                reject(promise, std::move(outcome.error()));
+        }
+
+        // Suspends cor, the consumer of a future, until the future is resolved; wake schedules its resumption.
+        // Multithreaded loops park the rendezvous only after cor has switched out.
+        virtual void suspend(FutureCoroutine *cor, _impl::Rendezvous &rendezvous, _impl::TaskNode &) {
+            if (rendezvous.park())
+                cor->yield();
+        }
+
+        // Runs fn once the current task is over and its coroutine has switched out, so that a consumer woken up by
+        // fn may safely free the producer; single-threaded loops can run it right away
+        virtual void defer(std::move_only_function<void()> fn) {
+            fn();
+        }
 
-        void add_task(std::move_only_function<void()> fn) {
-            add_task(std::forward<std::move_only_function<void()>>(fn), std::chrono::system_clock::now());
+        template<typename Functor, typename... Args>
+        Future<std::result_of_t<Functor(Args...)>> schedule_call(const bool stackless, Functor &&fn, Args &&... args) {
+            Future<std::result_of_t<Functor(Args...)>> future(this, [fn = std::forward<Functor>(fn), args = std::tuple<std::decay_t<Args>...>(std::forward<Args>(args)...)]() -> std::result_of_t<Functor(Args...)> {
+                return std::apply(fn, args);
+            });
+            Promise<std::result_of_t<Functor(Args...)>> promise;
+            _impl::Bond::bind(future, promise);
+            // The closures only hold the promise, which keeps them within the small buffer of the task function
+            if (stackless) {
+                emplace_task([promise = std::move(promise)]() -> void {
+                    promise.future().resolve();
+                });
+            } else {
+                emplace_task([promise = std::move(promise)]() -> void {
+                    promise.future().run();
+                });
+            }
+            return future;
         }
 
     public:
         void add_coroutine(Coroutine<void()> &cor) {
-            add_task([this, &cor]() mutable -> void {
+            emplace_task([this, &cor]() mutable -> void {
                 set_current_coroutine(&cor);
                 cor.resume();
                 set_current_coroutine(nullptr);
@@ -427,58 +388,156 @@ namespace AIO {
         }
 
         template<typename Functor, typename... Args>
+            requires(!std::is_same_v<std::decay_t<Functor>, NeverAwaits>)
         Future<std::result_of_t<Functor(Args...)>> async_call(Functor &&fn, Args &&... args) {
-            Future<std::result_of_t<Functor(Args...)>> future(this, [fn = std::forward<Functor>(fn), args = std::tuple<Args...>(std::forward<Args>(args)...)]() -> std::result_of_t<Functor(Args...)> {
-                return std::apply(fn, args);
-            });
-            Promise<std::result_of_t<Functor(Args...)>> promise;
-            _impl::Bond::bind(future, promise);
-            add_task([this, promise = std::move(promise)]() -> void {
-                set_current_coroutine(&promise.future());
-                promise.future().resume_impl(_impl::coroutine_void_t{});
-                set_current_coroutine(nullptr);
-            });
-            return future;
+            return schedule_call(false, std::forward<Functor>(fn), std::forward<Args>(args)...);
+        }
+
+        // Runs fn right on the loop's stack instead of giving it a coroutine and a stack of its own; fn must not
+        // await, an await() inside it fails as in synchronous context
+        template<typename Functor, typename... Args>
+        Future<std::result_of_t<Functor(Args...)>> async_call(NeverAwaits, Functor &&fn, Args &&... args) {
+            return schedule_call(true, std::forward<Functor>(fn), std::forward<Args>(args)...);
         }
 
         template<typename Functor>
+            requires(!std::is_same_v<std::decay_t<Functor>, NeverAwaits>)
         auto async(Functor &&fn) {
             return [this, fn = std::forward<Functor>(fn)] <typename... Args> (Args &&... args) -> auto { return async_call(fn, args...); };
         }
 
+        template<typename Functor>
+        auto async(NeverAwaits, Functor &&fn) {
+            return [this, fn = std::forward<Functor>(fn)] <typename... Args> (Args &&... args) -> auto {
+                return async_call(NEVER_AWAITS, fn, args...);
+            };
+        }
+
+        // Runs fn on a thread of the pool and resolves the future back on this loop, so that blocking system calls
+        // and heavy computations do not stall the other coroutines; await() rethrows what fn throws. A saturated
+        // pool delays the call.
+        template<typename Functor>
+        Future<std::invoke_result_t<Functor>> run_blocking(BlockingPool &pool, Functor &&fn) {
+            using Ret = std::invoke_result_t<Functor>;
+
+            auto promise = make_promise<Ret>();
+            auto future = make_future(promise);
+
+            // Only the loop touches the promise, the pool thread carries a pointer to it
+            auto *slot = new Promise<Ret>(std::move(promise));
+            expect_remote_task();
+            submit_blocking(pool, [this, slot, fn = std::forward<Functor>(fn)]() mutable -> void {
+                add_remote_task([slot, outcome = _impl::capture(fn)]() mutable -> void {
+                    settle(*slot, std::move(outcome));
+                    delete slot;
+                });
+            });
+            return future;
+        }
+
+        template<typename Functor>
+        Future<std::invoke_result_t<Functor>> run_blocking(Functor &&fn) {
+            return run_blocking(BlockingPool::instance(), std::forward<Functor>(fn));
+        }
+
         template<typename Rep, typename Period>
         Future<_impl::coroutine_void_t> sleep(const std::chrono::duration<Rep, Period> &dur) {
-            auto when = std::chrono::system_clock::now() + dur;
-            Future<_impl::coroutine_void_t> future(this, []() -> _impl::coroutine_void_t { return {}; });
-            Promise<_impl::coroutine_void_t> promise;
-            _impl::Bond::bind(future, promise);
-            add_task([this, promise = std::move(promise)]() -> void {
-                promise.future()({});
+            auto when = Clock::now() + dur;
+            auto promise = make_promise<_impl::coroutine_void_t>();
+            auto future = make_future(promise, []() -> _impl::coroutine_void_t { return {}; });
+            emplace_task([promise = std::move(promise)]() -> void {
+                resolve(promise);
             }, when);
             return future;
         }
+
+    private:
+        // Expects the backlog mutex to be held and the backlog of the pool not to be empty
+        void wait_for_room(BlockingPool &pool) {
+            expect_remote_task();
+            pool.notify_when_free([this, &pool]() -> void {
+                add_remote_task([this, &pool]() -> void {
+                    resubmit_blocking(pool);
+                });
+            });
+        }
+
+        void resubmit_blocking(BlockingPool &pool) {
+            std::lock_guard lock(backlog_mutex);
+            auto &backlog = backlogs[&pool];
+            while (!backlog.empty()) {
+                if (!pool.try_submit(std::move(backlog.front()))) {
+                    wait_for_room(pool);
+                    return;
+                }
+                backlog.pop_front();
+                backlogged.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Calls refused by saturated pools, in submission order per pool; a multithreaded loop submits from any of
+        // its threads, hence the mutex
+        std::mutex backlog_mutex;
+        std::unordered_map<BlockingPool *, std::deque<std::move_only_function<void()>>> backlogs;
+        std::atomic<std::size_t> backlogged = 0;
     };
 
     template<typename Ret>
-    _impl::coroutine_void_t Future<Ret>::operator()(_impl::coroutine_void_t) {
+    void Future<Ret>::resolve() {
         ret = fn();
-        if (cons.has_value()) (cons.value())();
-        return {};
+        notify();
+    }
+
+    template<typename Ret>
+    void Future<Ret>::resolve(Ret value) {
+        ret = std::move(value);
+        notify();
+    }
+
+    template<typename Ret>
+    void Future<Ret>::reject(std::exception_ptr exception) {
+        error = std::move(exception);
+        notify();
+    }
+
+    template<typename Ret>
+    void Future<Ret>::notify() {
+        loop->defer([this]() -> void {
+            if (rendezvous.resolve()) loop->add_task(&cons);
+        });
+    }
+
+    template<typename Ret>
+    void Future<Ret>::run() {
+        Coroutine<void()> &body = cor.emplace([this]() -> void {
+            resolve();
+        }, loop->get_stack_allocator());
+        loop->set_current_coroutine(&body);
+        body.resume();
+        loop->set_current_coroutine(nullptr);
+    }
+
+    template<typename Ret>
+    void Future<Ret>::resume_consumer(_impl::TaskNode *task) {
+        // The consumer may destroy the future, and the node with it, once it is resumed
+        const auto *continuation = static_cast<Continuation *>(task);
+        EventLoop *ev_loop = continuation->loop;
+        auto *cons_cor = continuation->cor;
+        ev_loop->set_current_coroutine(cons_cor);
+        cons_cor->resume();
+        ev_loop->set_current_coroutine(nullptr);
     }
 
     template<typename Ret>
     Ret Future<Ret>::await() {
-        if (cons.has_value()) _impl::assertion_failed("future already has a consumer");
+        if (cons.cor) assertion_failed("future already has a consumer");
         auto *cons_cor = loop->get_current_coroutine();
-        if (!cons_cor) _impl::assertion_failed("await() in synchronous context");
-        cons = [cons_cor, ev_loop = this->loop] () -> void {
-            ev_loop->add_task([cons_cor, ev_loop] () -> void {
-                ev_loop->set_current_coroutine(cons_cor);
-                cons_cor->resume_impl(_impl::coroutine_void_t{});
-                ev_loop->set_current_coroutine(nullptr);
-            });
-        };
-        if (!ret.has_value()) cons_cor->yield_impl(_impl::coroutine_void_t{});
+        if (!cons_cor) assertion_failed("await() in synchronous context");
+        cons.run = resume_consumer;
+        cons.loop = loop;
+        cons.cor = cons_cor;
+        if (!rendezvous.is_resolved()) loop->suspend(cons_cor, rendezvous, cons);
+        if (error) std::rethrow_exception(error);
         return std::move(ret.value());
     }
 
@@ -491,11 +550,30 @@ namespace AIO {
         });
     }
 
+    // Single-threaded loop. Other threads hand it work through post(); while idle it blocks on an eventfd that
+    // post() and stop() signal, so run_until_stopped() can wait for work that has not been posted yet.
     class SynchronousEventLoop final : public EventLoop {
+        StackPool stacks;
         FutureCoroutine *cur = nullptr;
-        std::multimap<std::chrono::time_point<std::chrono::system_clock>, std::move_only_function<void()>> tasks;
+        _impl::TaskQueue tasks;
+        _impl::DeadlineTimer timer;
+
+        // run() also waits for the tasks announced by expect_remote_task() that have not arrived yet
+        _impl::RemoteTasks remote;
+        std::atomic<bool> stopping = false;
+
+        // Loop that is running on the calling thread
+        static inline thread_local SynchronousEventLoop *running = nullptr;
+
+        void loop(bool until_stopped);
+
+        void wait(std::optional<Clock::time_point> deadline);
 
     protected:
+        [[nodiscard]] StackAllocator &get_stack_allocator() override {
+            return stacks;
+        }
+
         void set_current_coroutine(AIO::EventLoop::FutureCoroutine *cor) override {
             cur = cor;
         }
@@ -504,19 +582,76 @@ namespace AIO {
             return cur;
         }
 
-        void
-        add_task(std::move_only_function<void()> fn, std::chrono::time_point<std::chrono::system_clock> when) override {
-            tasks.emplace(when, std::forward<std::move_only_function<void()>>(fn));
+        void add_task(std::move_only_function<void()> fn, Clock::time_point when) override {
+            tasks.schedule(std::move(fn), when);
+        }
+
+        void add_task(std::move_only_function<void()> fn) override {
+            tasks.post(std::move(fn));
+        }
+
+        void add_task(_impl::TaskNode *task) override {
+            tasks.post(task);
+        }
+
+        [[nodiscard]] _impl::TaskQueue *get_task_queue() override {
+            return &tasks;
+        }
+
+        void expect_remote_task() override {
+            remote.expect();
+        }
+
+        void add_remote_task(std::move_only_function<void()> fn) override {
+            remote.add(std::move(fn));
         }
 
     public:
+        explicit SynchronousEventLoop(WaitStrategy strategy = WaitStrategy::SLEEP);
 
-        void run() {
-            while (!tasks.empty()) {
-                std::this_thread::sleep_until(tasks.begin()->first);
-                tasks.begin()->second();
-                tasks.erase(tasks.begin());
-            }
+        SynchronousEventLoop(const SynchronousEventLoop &) = delete;
+        SynchronousEventLoop &operator=(const SynchronousEventLoop &) = delete;
+
+        // Runs until no tasks are left, including the replies to post_future() and run_blocking(), or stop() is
+        // called
+        void run();
+
+        // Runs until stop() is called, waiting for posted tasks while there is nothing to do
+        void run_until_stopped();
+
+        // Makes run() and run_until_stopped() return after the current iteration; may be called from any thread
+        void stop();
+
+        // Queues fn to run on the loop's stack; may be called from any thread
+        void post(std::move_only_function<void()> fn) {
+            remote.post(std::move(fn));
+        }
+
+        // Runs fn on this loop for a coroutine of another SynchronousEventLoop (or of this one); the returned future
+        // belongs to the calling loop and resumes its consumer there, rethrowing what fn throws. Like a NEVER_AWAITS
+        // call, fn must not await.
+        template<typename Functor>
+        Future<std::invoke_result_t<Functor>> post_future(Functor &&fn) {
+            using Ret = std::invoke_result_t<Functor>;
+
+            SynchronousEventLoop *origin = running;
+            if (!origin)
+                assertion_failed("post_future() outside of a running loop");
+
+            auto promise = make_promise<Ret>();
+            auto future = origin->make_future(promise);
+
+            // The promise stays with the calling loop, which is the only one to touch it; an exception thrown by fn
+            // goes back there too instead of leaving this loop
+            auto *slot = new Promise<Ret>(std::move(promise));
+            origin->expect_remote_task();
+            post([origin, slot, fn = std::forward<Functor>(fn)]() mutable -> void {
+                origin->add_remote_task([slot, outcome = _impl::capture(fn)]() mutable -> void {
+                    settle(*slot, std::move(outcome));
+                    delete slot;
+                });
+            });
+            return future;
         }
 
         template<typename Functor>
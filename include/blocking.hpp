@@ -0,0 +1,61 @@
+#ifndef BLOCKING_H
+#define BLOCKING_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AIO {
+
+    // Fixed set of threads running calls that would stall an event loop, see EventLoop::run_blocking(). At most
+    // queue_depth calls wait for a free thread; once the queue is full, submissions are refused, and submitters may
+    // ask to be notified as calls leave the queue.
+    class BlockingPool {
+    public:
+        static constexpr std::size_t DEFAULT_THREADS = 16;
+        static constexpr std::size_t DEFAULT_QUEUE_DEPTH = 1024;
+
+        explicit BlockingPool(std::size_t threads = DEFAULT_THREADS, std::size_t queue_depth = DEFAULT_QUEUE_DEPTH);
+
+        BlockingPool(const BlockingPool &) = delete;
+        BlockingPool &operator=(const BlockingPool &) = delete;
+
+        // Any thread; leaves job untouched and returns false if the queue is full. The job must not throw, which
+        // would end the process: run_blocking() catches the exceptions of its calls and hands them to the loop.
+        bool try_submit(std::move_only_function<void()> &&job);
+
+        // Any thread; calls notify once the queue has room: right away if it has room now, otherwise on the pool
+        // thread that takes the next call off the queue. Each call taken off notifies one waiter, oldest first.
+        void notify_when_free(std::move_only_function<void()> &&notify);
+
+        [[nodiscard]] std::size_t get_thread_count() const;
+
+        [[nodiscard]] std::size_t get_queue_depth() const;
+
+        // Pool used by EventLoop::run_blocking() when no other pool is given
+        static BlockingPool &instance();
+
+        // Finishes the queued calls before joining the threads
+        ~BlockingPool();
+
+    private:
+        void work();
+
+        const std::size_t queue_depth;
+
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::deque<std::move_only_function<void()>> jobs;
+        std::deque<std::move_only_function<void()>> waiters;
+        bool stopping = false;
+
+        std::vector<std::jthread> threads;
+    };
+
+}
+
+#endif //BLOCKING_H
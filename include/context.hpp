@@ -4,12 +4,23 @@
 #include "abi.hpp"
 
 #include <cstddef>
+#include <cstdint>
 
 namespace AIO {
     extern "C" struct aio_context;
 
+    // Swaps the running context with the one stored in ctx
     extern "C" void aio_context_switch(aio_context *ctx);
 
+    // Saves the running context into from and resumes to, so from can be resumed later by another swap or jump
+    extern "C" void aio_context_swap(aio_context *from, const aio_context *to);
+
+    // Saves the running context into ctx and returns 0; returns again with 1 once ctx is resumed by a jump
+    extern "C" [[gnu::returns_twice]] int aio_context_save(aio_context *ctx);
+
+    // Resumes ctx and abandons the running context
+    extern "C" [[noreturn]] void aio_context_jump(const aio_context *ctx);
+
     extern "C" void aio_context_create(aio_context *ctx, void *stack, std::size_t stack_size, void (*entrypoint)());
 
 #ifdef AIO_SYSTEM_V_AMD64_ABI
@@ -23,6 +34,11 @@ namespace AIO {
             char reg[16];
         };
 
+        struct alignas(8) FPU {
+            char mxcsr[4];
+            char x87_control_word[2];
+        };
+
     public:
         R64 rip;
 
@@ -35,8 +51,69 @@ namespace AIO {
         R64 r13;
         R64 r14;
         R64 r15;
+
+        FPU fpu;
     };
-    static_assert(sizeof(aio_context) == 64);
+    static_assert(sizeof(aio_context) == 72);
+
+#if defined(__AVX512F__)
+#define AIO_VECTOR_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", \
+    "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "xmm16", "xmm17", "xmm18", "xmm19", "xmm20", "xmm21", "xmm22", \
+    "xmm23", "xmm24", "xmm25", "xmm26", "xmm27", "xmm28", "xmm29", "xmm30", "xmm31", \
+    "k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7"
+#else
+#define AIO_VECTOR_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", \
+    "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"
+#endif
+
+    // Same as aio_context_switch, but inlined into the caller. Every register except rsp and rbp is declared
+    // clobbered, so the compiler only spills what is live across the switch, and the running context saves just
+    // rip, rsp and rbp. Callee-saved registers are still loaded from ctx, so it interoperates with contexts saved
+    // or created by the out-of-line functions.
+    [[gnu::always_inline]] inline void aio_context_switch_inline(aio_context *ctx) {
+        struct alignas(8) {
+            std::uint32_t mxcsr;
+            std::uint16_t x87_control_word;
+        } fpu;
+        asm volatile(
+            "stmxcsr %[mxcsr]\n\t"
+            "fnstcw %[x87]\n\t"
+            "movq %[fpu], %%rax\n\t"
+            "movq 64(%[ctx]), %%rcx\n\t"
+            "movq %%rax, 64(%[ctx])\n\t"
+            "xorq %%rcx, %%rax\n\t"
+            "movabsq $0xffffffffffc0, %%rdx\n\t"
+            "testq %%rdx, %%rax\n\t"
+            "jz 2f\n\t"
+            "movq %%rcx, %[fpu]\n\t"
+            "ldmxcsr %[mxcsr]\n\t"
+            "fldcw %[x87]\n"                                // exchange floating-point control state
+            "2:\n\t"
+            "movq (%[ctx]), %%rax\n\t"
+            "movq 8(%[ctx]), %%rcx\n\t"
+            "movq 16(%[ctx]), %%rdx\n\t"
+            "leaq 1f(%%rip), %%rsi\n\t"
+            "movq %%rsi, (%[ctx])\n\t"
+            "movq %%rsp, 8(%[ctx])\n\t"
+            "movq %%rbp, 16(%[ctx])\n\t"                    // store continuation point, rsp and rbp
+            "movq 24(%[ctx]), %%rbx\n\t"
+            "movq 32(%[ctx]), %%r12\n\t"
+            "movq 40(%[ctx]), %%r13\n\t"
+            "movq 48(%[ctx]), %%r14\n\t"
+            "movq 56(%[ctx]), %%r15\n\t"
+            "movq %%rcx, %%rsp\n\t"
+            "movq %%rdx, %%rbp\n\t"
+            "jmpq *%%rax\n"                                 // load context registers and jump into its rip
+            "1:"
+            : [ctx] "+D"(ctx), [fpu] "=m"(fpu), [mxcsr] "=m"(fpu.mxcsr), [x87] "=m"(fpu.x87_control_word)
+            :
+            : "rax", "rcx", "rdx", "rsi", "r8", "r9", "r10", "r11", "rbx", "r12", "r13", "r14", "r15",
+              AIO_VECTOR_CLOBBERS, "st", "st(1)", "st(2)", "st(3)", "st(4)", "st(5)", "st(6)", "st(7)",
+              "memory", "cc"
+        );
+    }
+
+#undef AIO_VECTOR_CLOBBERS
 #else
 #error unsupported platform
 #endif
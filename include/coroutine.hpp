@@ -2,32 +2,35 @@
 #define COROUTINE_H
 
 #include <type_traits>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <span>
 
 #include "util.hpp"
 #include "context.hpp"
+#include "stack.hpp"
 
 namespace AIO {
 
     namespace _impl {
 
-        static inline thread_local void *volatile current_coroutine = nullptr;
+        inline thread_local void *volatile current_coroutine = nullptr;
 
-        static constexpr std::size_t COROUTINE_STACK_SIZE = 16 * 1024; // 16 KiB
+        static constexpr std::size_t COROUTINE_STACK_SIZE = DEFAULT_STACK_SIZE;
 
-        template<typename Ret, typename Arg>
-        struct MetaActualSignature {
-            using Type = Ret(Arg);
-        };
-
-        template<typename Ret>
-        struct MetaActualSignature<Ret, void> {
-            using Type = Ret();
-        };
+        // Coroutine bodies up to this size are stored at the top of the coroutine stack, larger ones on the heap
+        static constexpr std::size_t MAX_STACK_FUNCTOR_SIZE = 1024;
 
-        template<typename Ret, typename Arg>
-        using MetaActualSignatureT = typename MetaActualSignature<Ret, Arg>::Type;
+        // Coroutines inline their context switches when built with AIO_INLINE_CONTEXT_SWITCH
+        [[gnu::always_inline]] inline void switch_context(aio_context *ctx) {
+#ifdef AIO_INLINE_CONTEXT_SWITCH
+            aio_context_switch_inline(ctx);
+#else
+            aio_context_switch(ctx);
+#endif
+        }
 
         template<typename Ret, typename Arg, typename Derived>
         class CoroutineBase;
@@ -55,7 +58,15 @@ namespace AIO {
             template<typename Functor, typename FunctorDecay = std::decay_t<Functor> >
                 requires(!std::is_same_v<FunctorDecay, CoroutineBase>)
             /* implicit */ CoroutineBase(Functor &&fun) //NOLINT(*-explicit-constructor)
-                : fun(std::forward<Functor>(fun)), stack(prepare_stack()) { }
+                : CoroutineBase(std::forward<Functor>(fun), default_stack_allocator()) { }
+
+            template<typename Functor>
+            CoroutineBase(Functor &&fun, const std::size_t stack_size)
+                : CoroutineBase(std::forward<Functor>(fun), default_stack_allocator(), stack_size) { }
+
+            template<typename Functor>
+            CoroutineBase(Functor &&fun, StackAllocator &allocator, const std::size_t stack_size = COROUTINE_STACK_SIZE)
+                : stack(prepare_stack(allocator, stack_size, std::forward<Functor>(fun))) { }
 
             CoroutineBase(const CoroutineBase &) = delete;
             CoroutineBase(CoroutineBase &&other) = delete;
@@ -81,10 +92,33 @@ namespace AIO {
                 return static_cast<Derived *>(this)->yield_impl(std::forward<YieldRets>(ret) ..., false);
             }
 
+            // Suspends this coroutine and runs `other` in its place, without going through the resumer: `other`
+            // takes over the resumer of this coroutine, so its next yield returns there. Like yield(), returns once
+            // this coroutine is resumed again.
+            template<typename ...TransferArgs>
+            Arg transfer(Derived &other, TransferArgs && ...arg) {
+                if (current_coroutine != this)
+                    assertion_failed("attempt to transfer from another coroutine");
+                if (&other == this)
+                    assertion_failed("attempt to transfer to current coroutine");
+                if (other.is_dead())
+                    assertion_failed("attempt to transfer to dead coroutine");
+
+                return static_cast<Derived *>(this)->transfer_impl(other, std::forward<TransferArgs>(arg) ...);
+            }
+
             [[nodiscard]] bool is_dead() const {
                 return state != State::RUN;
             }
 
+            [[nodiscard]] std::size_t get_stack_size() const {
+                return stack.get_size();
+            }
+
+            [[nodiscard]] std::size_t get_stack_resident_size() const {
+                return stack.get_resident_size();
+            }
+
             void kill() {
                 if (current_coroutine == this)
                     assertion_failed("attempt to kill current coroutine");
@@ -95,7 +129,7 @@ namespace AIO {
 
                 void *prev_coroutine = current_coroutine;
                 current_coroutine = this;
-                aio_context_switch(&ctx);
+                switch_context(&ctx);
                 current_coroutine = prev_coroutine;
 
                 try {
@@ -109,14 +143,24 @@ namespace AIO {
                 if (!is_dead()) {
                     kill();
                 }
+                destroy_fun(fun);
             }
 
         private:
-            using SignatureT = MetaActualSignatureT<Ret, Arg>;
+            template<typename Functor>
+            using StoredFunctor = std::conditional_t<
+                sizeof(Functor) <= MAX_STACK_FUNCTOR_SIZE, Functor, std::unique_ptr<Functor>
+            >;
+
+            template<typename Functor>
+            static void destroy_functor(void *stored) noexcept {
+                std::destroy_at(static_cast<StoredFunctor<Functor> *>(stored));
+            }
 
+            template<typename Functor>
             [[noreturn]] static void entrypoint() noexcept {
                 try {
-                    Derived::entrypoint();
+                    Derived::template entrypoint<Functor>();
                 } catch (...) {
                     static_cast<CoroutineBase *>(current_coroutine)->yield_error_impl();
                 }
@@ -126,7 +170,7 @@ namespace AIO {
             void yield_error_impl() {
                 state = State::ERROR;
 
-                aio_context_switch(&ctx);
+                switch_context(&ctx);
             }
 
         protected:
@@ -134,14 +178,50 @@ namespace AIO {
                 RUN = 0, FINISH = 1, ERROR = 2
             };
 
-            std::unique_ptr<char[]> prepare_stack() {
-                auto stack = std::make_unique<char[]>(COROUTINE_STACK_SIZE);
+            // The body is moved to the top of the new stack and the frames of the coroutine start right below it,
+            // so a coroutine costs no allocation besides its stack and the entrypoint calls the body directly
+            template<typename Fun, typename Functor = std::decay_t<Fun> >
+            Stack prepare_stack(StackAllocator &allocator, const std::size_t stack_size, Fun &&body) {
+                if (stack_size < MIN_STACK_SIZE)
+                    assertion_failed("coroutine stack is too small");
+
+                using Stored = StoredFunctor<Functor>;
 
-                aio_context_create(&ctx, stack.get(), COROUTINE_STACK_SIZE, entrypoint);
+                Stack stack(allocator, stack_size);
+
+                const auto memory = reinterpret_cast<std::uintptr_t>(stack.get_memory());
+                const auto place = (memory + stack.get_size() - sizeof(Stored)) & ~(alignof(Stored) - 1);
+                if constexpr (std::is_same_v<Stored, Functor>) {
+                    fun = ::new(reinterpret_cast<void *>(place)) Stored(std::forward<Fun>(body));
+                } else {
+                    auto boxed = std::make_unique<Functor>(std::forward<Fun>(body));
+                    fun = ::new(reinterpret_cast<void *>(place)) Stored(std::move(boxed));
+                }
+                destroy_fun = destroy_functor<Functor>;
+
+                aio_context_create(&ctx, stack.get_memory(), place - memory, entrypoint<Functor>);
 
                 return stack;
             }
 
+            template<typename Functor>
+            Functor &functor() {
+                auto *stored = static_cast<StoredFunctor<Functor> *>(fun);
+                if constexpr (std::is_same_v<StoredFunctor<Functor>, Functor>) {
+                    return *stored;
+                } else {
+                    return **stored;
+                }
+            }
+
+            // The context of a running coroutine holds its resumer, which `other` inherits
+            void transfer_context(Derived &other) {
+                const aio_context target = other.ctx;
+                other.ctx = ctx;
+                current_coroutine = &other;
+                aio_context_swap(&ctx, &target);
+            }
+
             void check_rethrow() {
                 if (state == State::ERROR) {
                     throw;
@@ -157,8 +237,10 @@ namespace AIO {
             aio_context ctx { };
             State state = State::RUN;
 
-            std::move_only_function<SignatureT> fun;
-            std::unique_ptr<char[]> stack;
+            // Set up by prepare_stack(), so they must be declared before the stack
+            void *fun = nullptr;
+            void (*destroy_fun)(void *) noexcept = nullptr;
+            Stack stack;
         };
 
     }
@@ -182,31 +264,54 @@ namespace AIO {
 
             void *prev_coroutine = _impl::current_coroutine;
             _impl::current_coroutine = this;
-            aio_context_switch(&(Base::ctx));
+            _impl::switch_context(&(Base::ctx));
+            // The coroutine switching back may be one that this one transferred to
+            auto *last = static_cast<Coroutine *>(_impl::current_coroutine);
             _impl::current_coroutine = prev_coroutine;
 
-            Base::check_rethrow();
+            last->check_rethrow();
 
-            return *ret;
+            return *last->ret;
+        }
+
+        template<typename YieldRet>
+            requires(!std::is_convertible_v<std::remove_reference_t<YieldRet> *, std::remove_reference_t<Ret> *>)
+        Arg yield_impl(YieldRet &&ret, const bool finish) {
+            // Values of another type, such as a T yielded by a std::optional<T> generator, are converted here
+            RetV converted(std::forward<YieldRet>(ret));
+            return yield_impl(converted, finish);
         }
 
         template<typename YieldRet>
+            requires(std::is_convertible_v<std::remove_reference_t<YieldRet> *, std::remove_reference_t<Ret> *>)
         Arg yield_impl(YieldRet &&ret, const bool finish) {
             if (finish)
                 Base::state = Base::State::FINISH;
 
             this->ret = &ret;
 
-            aio_context_switch(&(Base::ctx));
+            _impl::switch_context(&(Base::ctx));
 
             Base::check_kill();
 
             return *arg;
         }
 
+        template<typename TransferArg>
+        Arg transfer_impl(Coroutine &other, TransferArg &&arg) {
+            other.arg = &arg;
+
+            Base::transfer_context(other);
+
+            Base::check_kill();
+
+            return *this->arg;
+        }
+
+        template<typename Functor>
         static void entrypoint() {
             auto *self = static_cast<Coroutine *>(_impl::current_coroutine);
-            self->yield_impl(self->fun(*self->arg), true);
+            self->yield_impl(std::invoke_r<Ret>(self->template functor<Functor>(), *self->arg), true);
         }
 
         using RetV = std::remove_reference_t<Ret>;
@@ -232,26 +337,40 @@ namespace AIO {
 
             void *prev_coroutine = _impl::current_coroutine;
             _impl::current_coroutine = this;
-            aio_context_switch(&(Base::ctx));
+            _impl::switch_context(&(Base::ctx));
+            // The coroutine switching back may be one that this one transferred to
+            auto *last = static_cast<Coroutine *>(_impl::current_coroutine);
             _impl::current_coroutine = prev_coroutine;
 
-            Base::check_rethrow();
+            last->check_rethrow();
         }
 
         Arg yield_impl(const bool finish) {
             if (finish)
                 Base::state = Base::State::FINISH;
 
-            aio_context_switch(&(Base::ctx));
+            _impl::switch_context(&(Base::ctx));
 
             Base::check_kill();
 
             return *arg;
         }
 
+        template<typename TransferArg>
+        Arg transfer_impl(Coroutine &other, TransferArg &&arg) {
+            other.arg = &arg;
+
+            Base::transfer_context(other);
+
+            Base::check_kill();
+
+            return *this->arg;
+        }
+
+        template<typename Functor>
         static void entrypoint() {
             auto *self = static_cast<Coroutine *>(_impl::current_coroutine);
-            self->fun(*self->arg);
+            std::invoke_r<void>(self->template functor<Functor>(), *self->arg);
             self->yield_impl(true);
         }
 
@@ -273,29 +392,47 @@ namespace AIO {
         Ret resume_impl() {
             void *prev_coroutine = _impl::current_coroutine;
             _impl::current_coroutine = this;
-            aio_context_switch(&(Base::ctx));
+            _impl::switch_context(&(Base::ctx));
+            // The coroutine switching back may be one that this one transferred to
+            auto *last = static_cast<Coroutine *>(_impl::current_coroutine);
             _impl::current_coroutine = prev_coroutine;
 
-            Base::check_rethrow();
+            last->check_rethrow();
+
+            return *last->ret;
+        }
 
-            return *ret;
+        template<typename YieldRet>
+            requires(!std::is_convertible_v<std::remove_reference_t<YieldRet> *, std::remove_reference_t<Ret> *>)
+        void yield_impl(YieldRet &&ret, const bool finish) {
+            // Values of another type, such as a T yielded by a std::optional<T> generator, are converted here
+            RetV converted(std::forward<YieldRet>(ret));
+            return yield_impl(converted, finish);
         }
 
         template<typename YieldRet>
+            requires(std::is_convertible_v<std::remove_reference_t<YieldRet> *, std::remove_reference_t<Ret> *>)
         void yield_impl(YieldRet &&ret, const bool finish) {
             if (finish)
                 Base::state = Base::State::FINISH;
 
             this->ret = &ret;
 
-            aio_context_switch(&(Base::ctx));
+            _impl::switch_context(&(Base::ctx));
 
             Base::check_kill();
         }
 
+        void transfer_impl(Coroutine &other) {
+            Base::transfer_context(other);
+
+            Base::check_kill();
+        }
+
+        template<typename Functor>
         static void entrypoint() {
             auto *self = static_cast<Coroutine *>(_impl::current_coroutine);
-            self->yield_impl(self->fun(), true);
+            self->yield_impl(std::invoke_r<Ret>(self->template functor<Functor>()), true);
         }
 
         using RetV = std::remove_reference_t<Ret>;
@@ -316,24 +453,33 @@ namespace AIO {
         void resume_impl() {
             void *prev_coroutine = _impl::current_coroutine;
             _impl::current_coroutine = this;
-            aio_context_switch(&ctx);
+            _impl::switch_context(&ctx);
+            // The coroutine switching back may be one that this one transferred to
+            auto *last = static_cast<Coroutine *>(_impl::current_coroutine);
             _impl::current_coroutine = prev_coroutine;
 
-            check_rethrow();
+            last->check_rethrow();
         }
 
         void yield_impl(const bool finish) {
             if (finish)
                 state = State::FINISH;
 
-            aio_context_switch(&ctx);
+            _impl::switch_context(&ctx);
+
+            check_kill();
+        }
+
+        void transfer_impl(Coroutine &other) {
+            transfer_context(other);
 
             check_kill();
         }
 
+        template<typename Functor>
         static void entrypoint() {
             auto *self = static_cast<Coroutine *>(_impl::current_coroutine);
-            self->fun();
+            std::invoke_r<void>(self->template functor<Functor>());
             self->yield_impl(true);
         }
     };
@@ -349,13 +495,137 @@ namespace AIO {
 
     struct CoroutineIteratorEnd { };
 
+    namespace _impl {
+
+        // How a generator coroutine reports its values and its end, and what an iterator keeps between resumes:
+        // - Ret: values are copied into the iterator, the generator throws EndGeneration once it is exhausted;
+        // - std::optional<T>: as above, but the generator ends by yielding or returning std::nullopt, which costs
+        //   no more than a context switch;
+        // - T &: the iterator refers to the yielded object in the suspended coroutine, nothing is copied;
+        // - std::span<T>: many values per switch, iterated one by one in place; an empty span ends the generator.
+        template<typename Ret>
+        struct GeneratorTraits {
+            using Value = Ret;
+
+            struct Cursor {
+                [[nodiscard]] bool has_value() const {
+                    return holder.has_value();
+                }
+
+                bool next(Coroutine<Ret()> &coro) {
+                    try {
+                        holder = coro.resume();
+                    } catch (const EndGeneration &) {
+                        holder = std::nullopt;
+                    }
+                    return holder.has_value();
+                }
+
+                Value *get() {
+                    return &holder.value();
+                }
+
+                void pop() {
+                    holder.reset();
+                }
+
+                std::optional<Value> holder = std::nullopt;
+            };
+        };
+
+        template<typename T>
+        struct GeneratorTraits<std::optional<T> > {
+            using Value = T;
+
+            struct Cursor {
+                [[nodiscard]] bool has_value() const {
+                    return holder.has_value();
+                }
+
+                bool next(Coroutine<std::optional<T>()> &coro) {
+                    holder = coro.resume();
+                    return holder.has_value();
+                }
+
+                Value *get() {
+                    return &holder.value();
+                }
+
+                void pop() {
+                    holder.reset();
+                }
+
+                std::optional<Value> holder = std::nullopt;
+            };
+        };
+
+        template<typename T>
+        struct GeneratorTraits<T &> {
+            using Value = T;
+
+            struct Cursor {
+                [[nodiscard]] bool has_value() const {
+                    return current != nullptr;
+                }
+
+                bool next(Coroutine<T &()> &coro) {
+                    try {
+                        current = &coro.resume();
+                    } catch (const EndGeneration &) {
+                        current = nullptr;
+                    }
+                    return current != nullptr;
+                }
+
+                Value *get() {
+                    return current;
+                }
+
+                void pop() {
+                    current = nullptr;
+                }
+
+                Value *current = nullptr;
+            };
+        };
+
+        template<typename T, std::size_t Extent>
+        struct GeneratorTraits<std::span<T, Extent> > {
+            using Value = T;
+
+            struct Cursor {
+                [[nodiscard]] bool has_value() const {
+                    return !rest.empty();
+                }
+
+                bool next(Coroutine<std::span<T, Extent>()> &coro) {
+                    rest = coro.resume();
+                    return !rest.empty();
+                }
+
+                Value *get() {
+                    return rest.data();
+                }
+
+                void pop() {
+                    rest = rest.subspan(1);
+                }
+
+                std::span<T> rest;
+            };
+        };
+
+    }
+
     template<typename Ret>
     class CoroutineIterator {
+        using Traits = _impl::GeneratorTraits<Ret>;
+
     public:
         using iterator_category = std::forward_iterator_tag;
-        using value_type = Ret;
-        using pointer = Ret *;
-        using reference = Ret &;
+        using value_type = typename Traits::Value;
+        using pointer = value_type *;
+        using reference = value_type &;
         using difference_type = std::ptrdiff_t;
 
         explicit CoroutineIterator(Coroutine<Ret()> &coro) : coro(&coro) { }
@@ -363,30 +633,31 @@ namespace AIO {
         // ReSharper disable once CppNonExplicitConvertingConstructor
         CoroutineIterator(CoroutineIteratorEnd) { } //NOLINT(*-explicit-constructor)
 
-        CoroutineIterator(const CoroutineIterator &other) : coro(other.coro) { }
+        CoroutineIterator(const CoroutineIterator &other) : coro(other.coro), cursor(other.cursor) { }
 
         CoroutineIterator &operator=(const CoroutineIterator &other) {
             if (&other == this)
                 return *this;
 
             coro = other.coro;
+            cursor = other.cursor;
             return *this;
         }
 
         CoroutineIterator(CoroutineIterator &&) = delete;
         CoroutineIterator &operator=(CoroutineIterator &&) = delete;
 
-        Ret &operator*() const {
+        reference operator*() const {
             return *this->operator->();
         }
 
-        Ret *operator->() const {
+        pointer operator->() const {
             obtain_value();
 
             if (!coro)
                 assertion_failed("dereferencing singular iterator");
 
-            return &holder.value();
+            return cursor.get();
         }
 
         CoroutineIterator &operator++() {
@@ -395,7 +666,7 @@ namespace AIO {
             if (!coro)
                 assertion_failed("incrementing singular iterator");
 
-            holder.reset();
+            cursor.pop();
 
             return *this;
         }
@@ -415,24 +686,15 @@ namespace AIO {
             if (!coro)
                 return;
 
-            if (holder.has_value())
+            if (cursor.has_value())
                 return;
 
-            if (coro->is_dead()) {
-                coro = nullptr;
-                holder = std::nullopt;
-            }
-
-            try {
-                holder = coro->resume();
-            } catch (const EndGeneration &) {
+            if (coro->is_dead() || !cursor.next(*coro))
                 coro = nullptr;
-                holder = std::nullopt;
-            }
         }
 
         mutable Coroutine<Ret()> *coro = nullptr;
-        mutable std::optional<Ret> holder = std::nullopt;
+        mutable typename Traits::Cursor cursor { };
     };
 
     template<typename Ret>
@@ -451,6 +713,10 @@ namespace AIO {
             return CoroutineIteratorEnd();
         }
 
+        [[nodiscard]] Coroutine<Ret()> *get_coroutine() const {
+            return coro;
+        }
+
     private:
         Coroutine<Ret()> *coro = nullptr;
     };
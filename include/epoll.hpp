@@ -0,0 +1,138 @@
+#ifndef EPOLL_H
+#define EPOLL_H
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include "aio.hpp"
+
+namespace AIO {
+
+    // Reactor loop: timed tasks plus edge-triggered readiness notifications for file descriptors.
+    // Each iteration makes a single epoll_pwait2() call, bounded by the deadline of the earliest task
+    // as the wait strategy dictates; with TIMERFD the deadline is a timerfd in the epoll set instead, and with
+    // SPIN the loop busy-waits the last SPIN_THRESHOLD without entering the kernel.
+    // Takes the results of run_blocking() from other threads through an eventfd in the same set.
+    class EpollEventLoop final : public EventLoop {
+    public:
+        explicit EpollEventLoop(WaitStrategy strategy = WaitStrategy::SLEEP);
+
+        EpollEventLoop(const EpollEventLoop &) = delete;
+        EpollEventLoop &operator=(const EpollEventLoop &) = delete;
+
+        // Resolves once fd becomes readable (or hung up / errored) after its last reported readiness
+        Future<_impl::coroutine_void_t> readable(int fd);
+
+        // Resolves once fd becomes writable (or errored) after its last reported readiness
+        Future<_impl::coroutine_void_t> writable(int fd);
+
+        // Resolves to the first result of attempt() other than -EAGAIN. attempt() makes a non-blocking system call
+        // on fd and returns its result or -errno; it is called right away and then every time fd becomes ready in
+        // the given direction, from the loop itself, so a pending operation takes no coroutine
+        Future<ssize_t> perform(int fd, bool write, std::move_only_function<ssize_t()> attempt);
+
+        // perform() whose future resolves to convert(result) instead, computed by the loop as the operation ends
+        template<typename Convert>
+        Future<std::invoke_result_t<Convert &, ssize_t>> perform(
+            const int fd, const bool write, std::move_only_function<ssize_t()> attempt, Convert &&convert
+        ) {
+            using Ret = std::invoke_result_t<Convert &, ssize_t>;
+
+            auto promise = make_promise<Ret>();
+            auto future = make_future(promise);
+            start(fd, write, std::move(attempt), [
+                promise = std::move(promise), convert = std::forward<Convert>(convert)
+            ](const ssize_t result) mutable -> void {
+                resolve(promise, convert(result));
+            });
+            return future;
+        }
+
+        // Stops watching fd; must be called before the descriptor is closed
+        void forget(int fd);
+
+        void run();
+
+        template<typename Functor>
+        static void create_and_run(Functor &&fn) {
+            EpollEventLoop loop;
+            Coroutine<void()> cor = [&loop, fn = std::forward<Functor>(fn)]() -> void {
+                fn(loop);
+            };
+            loop.add_coroutine(cor);
+            loop.run();
+        }
+
+        ~EpollEventLoop();
+
+    protected:
+        [[nodiscard]] StackAllocator &get_stack_allocator() override;
+
+        void set_current_coroutine(FutureCoroutine *cor) override;
+
+        [[nodiscard]] FutureCoroutine *get_current_coroutine() const override;
+
+        void add_task(std::move_only_function<void()> fn, Clock::time_point when) override;
+
+        void add_task(std::move_only_function<void()> fn) override;
+
+        void add_task(_impl::TaskNode *task) override;
+
+        [[nodiscard]] _impl::TaskQueue *get_task_queue() override;
+
+        void expect_remote_task() override;
+
+        void add_remote_task(std::move_only_function<void()> fn) override;
+
+    private:
+        using EventPromise = Promise<_impl::coroutine_void_t>;
+
+        struct Operation {
+            std::move_only_function<ssize_t()> attempt;
+            // Resolves the operation's future from the final result
+            std::move_only_function<void(ssize_t)> complete;
+        };
+
+        struct Watch {
+            bool readable = false;
+            bool writable = false;
+            std::optional<EventPromise> reader;
+            std::optional<EventPromise> writer;
+            std::optional<Operation> read_operation;
+            std::optional<Operation> write_operation;
+        };
+
+        static constexpr int MAX_EVENTS = 256;
+
+        Watch &watch(int fd);
+
+        void start(
+            int fd, bool write, std::move_only_function<ssize_t()> attempt,
+            std::move_only_function<void(ssize_t)> complete
+        );
+
+        Future<_impl::coroutine_void_t> wait(bool Watch::*ready, std::optional<EventPromise> Watch::*waiter, int fd);
+
+        // Returns false if the wait timed out with no descriptor ready
+        bool dispatch(std::optional<Clock::duration> timeout);
+
+        int epoll_fd;
+        std::size_t waiters = 0;
+
+        StackPool stacks;
+        FutureCoroutine *cur = nullptr;
+        _impl::TaskQueue tasks;
+        _impl::DeadlineTimer timer;
+        // Its descriptor is in the epoll set, so that other threads can wake the loop
+        _impl::RemoteTasks remote;
+        std::unordered_map<int, Watch> watches;
+    };
+
+}
+
+#endif //EPOLL_H
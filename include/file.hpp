@@ -0,0 +1,97 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+#include <sys/types.h>
+
+#include "aio.hpp"
+#include "coroutine.hpp"
+
+namespace AIO {
+
+    static constexpr std::size_t DEFAULT_FILE_CHUNK_SIZE = 64 * 1024; // 64 KiB
+    static constexpr std::size_t DEFAULT_FILE_READAHEAD = 1024 * 1024; // 1 MiB
+
+    // Generator of the consecutive chunks of a file: each resume returns the next chunk, valid until the following
+    // resume, and an empty span marks the end, so CoroutineGenerator walks the bytes of the file in place.
+    // Read errors are thrown from resume() as std::system_error.
+    using FileChunks = Coroutine<std::span<const std::byte>()>;
+
+    // Reads the file in chunks of chunk_size into a buffer of the generator, asking the kernel to read `readahead`
+    // bytes ahead of the position with posix_fadvise(); throws std::system_error if the file cannot be opened
+    FileChunks read_file(
+        const std::string &path, std::size_t chunk_size = DEFAULT_FILE_CHUNK_SIZE,
+        std::size_t readahead = DEFAULT_FILE_READAHEAD
+    );
+
+    // Maps the file and returns views of chunk_size into the mapping, so no byte is copied; pages are requested
+    // `readahead` bytes ahead with madvise(). Throws std::system_error if the file cannot be opened or mapped.
+    FileChunks map_file(
+        const std::string &path, std::size_t chunk_size = DEFAULT_FILE_CHUNK_SIZE,
+        std::size_t readahead = DEFAULT_FILE_READAHEAD
+    );
+
+    class UringEventLoop;
+
+    // Chunked reader that reads ahead: while the consumer works on one chunk, the next one is already being read.
+    // On a UringEventLoop the reads are operations of the ring; on any other loop they run on a BlockingPool
+    // through EventLoop::run_blocking().
+    class AsyncFileReader {
+    public:
+        // Starts reading the first chunk; throws std::system_error if the file cannot be opened
+        AsyncFileReader(
+            EventLoop &loop, const std::string &path, std::size_t chunk_size = DEFAULT_FILE_CHUNK_SIZE,
+            BlockingPool &pool = BlockingPool::instance()
+        );
+
+        AsyncFileReader(
+            UringEventLoop &loop, const std::string &path, std::size_t chunk_size = DEFAULT_FILE_CHUNK_SIZE
+        );
+
+        AsyncFileReader(const AsyncFileReader &) = delete;
+        AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+        // Resolves to the next chunk, valid until the following call. An empty span marks the end of the file, or
+        // a read error that get_error() then reports.
+        Future<std::span<const std::byte>> next();
+
+        // errno of the failed read, 0 if there was none
+        [[nodiscard]] int get_error() const;
+
+        // Waits for the read in flight, so a reader that has not reached the end must be destroyed in a coroutine
+        ~AsyncFileReader();
+
+    private:
+        AsyncFileReader(EventLoop &loop, UringEventLoop *ring, BlockingPool *pool, const std::string &path,
+                        std::size_t chunk_size);
+
+        void prefetch();
+
+        // Waits for the chunk being read into buffers[filling]; returns its size or -errno
+        ssize_t collect();
+
+        EventLoop &loop;
+        // Exactly one of them is set
+        UringEventLoop *ring;
+        BlockingPool *pool;
+        int fd;
+        const std::size_t chunk_size;
+        off_t offset = 0;
+        int error = 0;
+
+        // The pool or the ring reads into one buffer while the consumer holds the other
+        std::unique_ptr<std::byte[]> buffers[2];
+        std::size_t filling = 0;
+        std::optional<Future<ssize_t>> pending;
+        // Read of the ring in flight, which may come out short and is then topped up by collect()
+        std::optional<Future<int>> reading;
+    };
+
+}
+
+#endif //FILE_H
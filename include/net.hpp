@@ -0,0 +1,118 @@
+#ifndef NET_H
+#define NET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "epoll.hpp"
+
+namespace AIO {
+
+    // Non-blocking stream socket on an EpollEventLoop, which owns its descriptor. Transfers resolve like the system
+    // calls behind them: a byte count on success, -errno on failure; one that fails after moving some bytes resolves
+    // to that short count, so the caller knows how much got through. An operation that would block waits for the
+    // loop to report the socket ready and retries from there, without a coroutine of its own. At most one operation
+    // may be pending per direction; the stream may be moved meanwhile, but not destroyed.
+    class Stream {
+    public:
+        // Takes over fd and switches it to non-blocking mode
+        Stream(EpollEventLoop &loop, int fd);
+
+        Stream(const Stream &) = delete;
+        Stream &operator=(const Stream &) = delete;
+
+        Stream(Stream &&other) noexcept;
+
+        Stream &operator=(Stream &&other) noexcept;
+
+        // Reads whatever is available, up to the size of the buffer; 0 means end of stream
+        Future<ssize_t> read(std::span<std::byte> buffer);
+
+        // Fills the whole buffer; resolves to a shorter count if the stream ends first
+        Future<ssize_t> read_exact(std::span<std::byte> buffer);
+
+        // Writes the whole buffer, unless an error cuts it short
+        Future<ssize_t> write(std::span<const std::byte> buffer);
+
+        // Writes all the buffers with vectored writes, in as few system calls as the socket allows
+        Future<ssize_t> writev(std::span<const iovec> buffers);
+
+        // Sends count bytes of a file starting at offset with sendfile(), or spliced through a pipe when the file
+        // does not support sendfile(); the data never passes through user space
+        Future<ssize_t> send_file(int file_fd, off_t offset, std::size_t count);
+
+        // Shuts down the writing side, the peer then reads the end of stream
+        void shutdown_write();
+
+        [[nodiscard]] int get_fd() const;
+
+        virtual ~Stream();
+
+    protected:
+        void close();
+
+        EpollEventLoop *loop;
+        int fd;
+    };
+
+    class TcpStream final : public Stream {
+    public:
+        using Stream::Stream;
+
+        // New unconnected socket of the given address family; throws std::system_error on failure
+        static TcpStream open(EpollEventLoop &loop, int family = AF_INET);
+
+        // Resolves to 0 once connected, -errno on failure
+        Future<ssize_t> connect(const sockaddr *address, socklen_t length);
+
+        void set_nodelay(bool nodelay);
+    };
+
+    class UnixStream final : public Stream {
+    public:
+        using Stream::Stream;
+
+        // New unconnected socket; throws std::system_error on failure
+        static UnixStream open(EpollEventLoop &loop);
+
+        // Connected pair of sockets; throws std::system_error on failure
+        static std::pair<UnixStream, UnixStream> pair(EpollEventLoop &loop);
+
+        // Resolves to 0 once connected, -errno on failure
+        Future<ssize_t> connect(const std::string &path);
+    };
+
+    class TcpListener {
+    public:
+        // Listening socket bound to the address; throws std::system_error on failure
+        TcpListener(EpollEventLoop &loop, const sockaddr *address, socklen_t length, int backlog = SOMAXCONN);
+
+        TcpListener(const TcpListener &) = delete;
+        TcpListener &operator=(const TcpListener &) = delete;
+
+        // Resolves to the next incoming connection, or to errno on failure
+        Future<std::expected<TcpStream, int>> accept();
+
+        // Port the listener is bound to, useful after binding to port 0
+        [[nodiscard]] std::uint16_t get_port() const;
+
+        [[nodiscard]] int get_fd() const;
+
+        ~TcpListener();
+
+    private:
+        EpollEventLoop &loop;
+        int fd;
+    };
+
+}
+
+#endif //NET_H
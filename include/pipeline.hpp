@@ -0,0 +1,401 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "coroutine.hpp"
+
+namespace AIO {
+
+    namespace _impl {
+
+        struct StageEnd { };
+
+        // Input iterator over a stage; the value it refers to stays valid until it is incremented
+        template<typename Stage>
+        class StageIterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = typename Stage::Value;
+            using pointer = value_type *;
+            using reference = value_type &;
+            using difference_type = std::ptrdiff_t;
+
+            explicit StageIterator(Stage &stage) : stage(&stage), current(stage.next()) { }
+
+            reference operator*() const {
+                return *current;
+            }
+
+            pointer operator->() const {
+                return current;
+            }
+
+            StageIterator &operator++() {
+                current = stage->next();
+                return *this;
+            }
+
+            void operator++(int) {
+                ++*this;
+            }
+
+            bool operator==(StageEnd) const {
+                return current == nullptr;
+            }
+
+        private:
+            Stage *stage;
+            pointer current;
+        };
+
+        // Pull-based pipeline stage: next() moves to the following value and returns a pointer to it, valid until
+        // the next call, or nullptr from the moment the stage is exhausted. Stages own their upstream stage and run
+        // inside the consumer's iteration, so only a coroutine source has a stack and a context switch of its own.
+        template<typename Derived>
+        class Stage {
+        public:
+            StageIterator<Derived> begin() {
+                return StageIterator<Derived>(static_cast<Derived &>(*this));
+            }
+
+            StageEnd end() {
+                return { };
+            }
+        };
+
+        template<typename T>
+        concept IsStage = std::is_base_of_v<Stage<std::remove_cvref_t<T> >, std::remove_cvref_t<T> >;
+
+        template<typename T>
+        inline constexpr bool is_coroutine_generator = false;
+
+        template<typename Ret>
+        inline constexpr bool is_coroutine_generator<CoroutineGenerator<Ret> > = true;
+
+        template<typename T>
+        concept IsRange = !IsStage<T> && !is_coroutine_generator<std::remove_cvref_t<T> > && requires(T &range) {
+            std::begin(range);
+            std::end(range);
+        };
+
+        template<typename Ret>
+        class CoroutineSource final : public Stage<CoroutineSource<Ret> > {
+            using Traits = GeneratorTraits<Ret>;
+
+        public:
+            using Value = typename Traits::Value;
+
+            explicit CoroutineSource(Coroutine<Ret()> *coro) : coro(coro) { }
+
+            Value *next() {
+                if (!coro)
+                    return nullptr;
+
+                if (cursor.has_value())
+                    cursor.pop();
+                if (!cursor.has_value() && (coro->is_dead() || !cursor.next(*coro))) {
+                    coro = nullptr;
+                    return nullptr;
+                }
+                return cursor.get();
+            }
+
+        private:
+            Coroutine<Ret()> *coro;
+            typename Traits::Cursor cursor { };
+        };
+
+        // Iterates a container or any other range, owning it if it was passed as an rvalue
+        template<typename Range>
+        class RangeSource final : public Stage<RangeSource<Range> > {
+            using Iterator = decltype(std::begin(std::declval<std::remove_reference_t<Range> &>()));
+            using Reference = std::iter_reference_t<Iterator>;
+
+            struct NoSlot { };
+
+        public:
+            using Value = std::remove_reference_t<Reference>;
+
+            explicit RangeSource(Range &&range) : range(std::forward<Range>(range)) { }
+
+            Value *next() {
+                if (!it.has_value())
+                    it.emplace(std::begin(range));
+                else if (*it != std::end(range))
+                    ++*it;
+
+                if (*it == std::end(range))
+                    return nullptr;
+
+                if constexpr (std::is_lvalue_reference_v<Reference>) {
+                    return &**it;
+                } else {
+                    slot.emplace(**it);
+                    return &*slot;
+                }
+            }
+
+        private:
+            Range range;
+            std::optional<Iterator> it;
+            std::conditional_t<std::is_lvalue_reference_v<Reference>, NoSlot, std::optional<Value> > slot;
+        };
+
+        template<typename Ret>
+        CoroutineSource<Ret> make_source(Coroutine<Ret()> &coro) {
+            return CoroutineSource<Ret>(&coro);
+        }
+
+        template<typename Ret>
+        CoroutineSource<Ret> make_source(const CoroutineGenerator<Ret> &generator) {
+            return CoroutineSource<Ret>(generator.get_coroutine());
+        }
+
+        template<typename Source>
+            requires IsStage<Source>
+        std::remove_cvref_t<Source> make_source(Source &&stage) {
+            return std::forward<Source>(stage);
+        }
+
+        template<typename Range>
+            requires IsRange<Range>
+        RangeSource<Range> make_source(Range &&range) {
+            return RangeSource<Range>(std::forward<Range>(range));
+        }
+
+        template<typename Source>
+        using SourceOf = decltype(make_source(std::declval<Source>()));
+
+        template<typename Source, typename Fn>
+        class MapStage final : public Stage<MapStage<Source, Fn> > {
+            using Result = std::invoke_result_t<Fn &, typename Source::Value &>;
+
+        public:
+            using Value = std::remove_reference_t<Result>;
+
+            MapStage(Source source, Fn fn) : source(std::move(source)), fn(std::move(fn)) { }
+
+            Value *next() {
+                auto *value = source.next();
+                if (!value)
+                    return nullptr;
+
+                if constexpr (std::is_lvalue_reference_v<Result>) {
+                    return &std::invoke(fn, *value);
+                } else {
+                    slot.emplace(std::invoke(fn, *value));
+                    return &*slot;
+                }
+            }
+
+        private:
+            Source source;
+            Fn fn;
+            std::optional<Value> slot;
+        };
+
+        template<typename Source, typename Predicate>
+        class FilterStage final : public Stage<FilterStage<Source, Predicate> > {
+        public:
+            using Value = typename Source::Value;
+
+            FilterStage(Source source, Predicate predicate)
+                : source(std::move(source)), predicate(std::move(predicate)) { }
+
+            Value *next() {
+                while (auto *value = source.next()) {
+                    if (std::invoke(predicate, std::as_const(*value)))
+                        return value;
+                }
+                return nullptr;
+            }
+
+        private:
+            Source source;
+            Predicate predicate;
+        };
+
+        template<typename Source>
+        class TakeStage final : public Stage<TakeStage<Source> > {
+        public:
+            using Value = typename Source::Value;
+
+            TakeStage(Source source, const std::size_t count) : source(std::move(source)), remaining(count) { }
+
+            // Stops pulling once the count is reached, so a generator is not resumed past the last value taken
+            Value *next() {
+                if (remaining == 0)
+                    return nullptr;
+                remaining--;
+                return source.next();
+            }
+
+        private:
+            Source source;
+            std::size_t remaining;
+        };
+
+        template<typename Source>
+        class ChunkStage final : public Stage<ChunkStage<Source> > {
+        public:
+            using Value = std::vector<std::remove_cv_t<typename Source::Value> >;
+
+            ChunkStage(Source source, const std::size_t size) : source(std::move(source)), size(size) {
+                if (size == 0)
+                    assertion_failed("chunk size must be positive");
+                buffer.reserve(size);
+            }
+
+            // The last chunk may be shorter
+            Value *next() {
+                buffer.clear();
+                while (buffer.size() < size) {
+                    auto *value = source.next();
+                    if (!value)
+                        break;
+                    buffer.push_back(*value);
+                }
+                return buffer.empty() ? nullptr : &buffer;
+            }
+
+        private:
+            Source source;
+            std::size_t size;
+            Value buffer;
+        };
+
+        template<typename ...Sources>
+        class ZipStage final : public Stage<ZipStage<Sources...> > {
+        public:
+            using Value = std::tuple<typename Sources::Value &...>;
+
+            explicit ZipStage(Sources ...sources) : sources(std::move(sources)...) { }
+
+            // Ends with the shortest source; sources after the first exhausted one are not pulled
+            Value *next() {
+                if (exhausted || !pull(std::index_sequence_for<Sources...>())) {
+                    exhausted = true;
+                    return nullptr;
+                }
+
+                std::apply([this](auto *...value) {
+                    slot.emplace(*value...);
+                }, values);
+                return &*slot;
+            }
+
+        private:
+            template<std::size_t ...I>
+            bool pull(std::index_sequence<I...>) {
+                return (... && ((std::get<I>(values) = std::get<I>(sources).next()) != nullptr));
+            }
+
+            std::tuple<Sources...> sources;
+            std::tuple<typename Sources::Value *...> values;
+            std::optional<Value> slot;
+            bool exhausted = false;
+        };
+
+        template<typename Source, typename Fn>
+        class FlatMapStage final : public Stage<FlatMapStage<Source, Fn> > {
+            using Inner = SourceOf<std::invoke_result_t<Fn &, typename Source::Value &> >;
+
+        public:
+            using Value = typename Inner::Value;
+
+            FlatMapStage(Source source, Fn fn) : source(std::move(source)), fn(std::move(fn)) { }
+
+            Value *next() {
+                while (true) {
+                    if (inner.has_value()) {
+                        if (auto *value = inner->next())
+                            return value;
+                    }
+
+                    auto *outer = source.next();
+                    if (!outer)
+                        return nullptr;
+                    inner.emplace(make_source(std::invoke(fn, *outer)));
+                }
+            }
+
+        private:
+            Source source;
+            Fn fn;
+            std::optional<Inner> inner;
+        };
+
+        template<typename Make>
+        struct Adaptor {
+            Make make;
+        };
+
+        // source | adaptor, where the source is a coroutine, a CoroutineGenerator, a range or another stage
+        template<typename Source, typename Make>
+            requires requires(Source &&source) { make_source(std::forward<Source>(source)); }
+        auto operator|(Source &&source, Adaptor<Make> adaptor) {
+            return std::move(adaptor.make)(make_source(std::forward<Source>(source)));
+        }
+
+    }
+
+    // Range-style adaptors over generators: `generator | views::filter(p) | views::map(f) | views::take(n)`.
+    // All stages are fused into the consumer's loop, only the generator at the source runs on its own stack.
+    // Values are pulled on demand and referenced in place where possible, a reference obtained from an
+    // iterator stays valid until the iterator is incremented.
+    namespace views {
+
+        template<typename Fn>
+        auto map(Fn fn) {
+            return _impl::Adaptor { [fn = std::move(fn)]<typename Source>(Source source) mutable {
+                return _impl::MapStage<Source, Fn>(std::move(source), std::move(fn));
+            } };
+        }
+
+        template<typename Predicate>
+        auto filter(Predicate predicate) {
+            return _impl::Adaptor { [predicate = std::move(predicate)]<typename Source>(Source source) mutable {
+                return _impl::FilterStage<Source, Predicate>(std::move(source), std::move(predicate));
+            } };
+        }
+
+        inline auto take(const std::size_t count) {
+            return _impl::Adaptor { [count]<typename Source>(Source source) {
+                return _impl::TakeStage<Source>(std::move(source), count);
+            } };
+        }
+
+        // Groups values into vectors of `size` copies
+        inline auto chunk(const std::size_t size) {
+            return _impl::Adaptor { [size]<typename Source>(Source source) {
+                return _impl::ChunkStage<Source>(std::move(source), size);
+            } };
+        }
+
+        // Maps every value to a coroutine, a CoroutineGenerator, a range or a stage and iterates it in turn
+        template<typename Fn>
+        auto flat_map(Fn fn) {
+            return _impl::Adaptor { [fn = std::move(fn)]<typename Source>(Source source) mutable {
+                return _impl::FlatMapStage<Source, Fn>(std::move(source), std::move(fn));
+            } };
+        }
+
+        // Tuples of references to the values of all sources, up to the end of the shortest one
+        template<typename ...Sources>
+        auto zip(Sources &&...sources) {
+            return _impl::ZipStage<_impl::SourceOf<Sources>...>(_impl::make_source(std::forward<Sources>(sources))...);
+        }
+
+    }
+
+}
+
+#endif //PIPELINE_H
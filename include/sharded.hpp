@@ -0,0 +1,219 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "aio.hpp"
+
+namespace AIO {
+
+    namespace _impl {
+
+        // Bounded single-producer single-consumer queue. Each side caches the other side's index, so the shared
+        // cache lines are only touched when the cached value runs out.
+        template<typename T>
+        class SpscRing {
+        public:
+            explicit SpscRing(std::size_t capacity = 1024)
+                : mask(std::bit_ceil(capacity) - 1), slots(std::make_unique<T[]>(mask + 1)) {}
+
+            SpscRing(const SpscRing &) = delete;
+            SpscRing &operator=(const SpscRing &) = delete;
+
+            // Producer only; leaves item untouched and returns false if the ring is full
+            bool try_push(T &&item) {
+                const std::size_t t = tail.load(std::memory_order_relaxed);
+                if (t - cached_head > mask) {
+                    cached_head = head.load(std::memory_order_acquire);
+                    if (t - cached_head > mask)
+                        return false;
+                }
+                slots[t & mask] = std::move(item);
+                tail.store(t + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Consumer only
+            bool try_pop(T &item) {
+                const std::size_t h = head.load(std::memory_order_relaxed);
+                if (h == cached_tail) {
+                    cached_tail = tail.load(std::memory_order_acquire);
+                    if (h == cached_tail)
+                        return false;
+                }
+                item = std::move(slots[h & mask]);
+                head.store(h + 1, std::memory_order_release);
+                return true;
+            }
+
+            [[nodiscard]] bool empty() const {
+                return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+            }
+
+        private:
+            alignas(64) std::atomic<std::size_t> head = 0;
+            std::size_t cached_tail = 0;
+            alignas(64) std::atomic<std::size_t> tail = 0;
+            std::size_t cached_head = 0;
+            alignas(64) const std::size_t mask;
+            std::unique_ptr<T[]> slots;
+        };
+
+    }
+
+    // Share-nothing alternative to WorkStealingEventLoop: one single-threaded loop per shard, each on its own
+    // thread pinned to a CPU, with its own task queue and stack pool. Shards only talk through SPSC rings, and
+    // submit_to() keeps the Future and its Promise on the calling shard; only the call and its result travel.
+    class ShardedEventLoop {
+    public:
+        explicit ShardedEventLoop(std::size_t shards = std::thread::hardware_concurrency(), bool pin = true);
+
+        ShardedEventLoop(const ShardedEventLoop &) = delete;
+        ShardedEventLoop &operator=(const ShardedEventLoop &) = delete;
+
+        // Loop of a shard; other threads may add tasks to it only before run()
+        [[nodiscard]] EventLoop &shard(std::size_t index);
+
+        [[nodiscard]] std::size_t get_shard_count() const;
+
+        // Index of the shard running the calling thread
+        [[nodiscard]] std::size_t current_shard() const;
+
+        // Runs fn(EventLoop &) in a coroutine on the given shard; the returned future belongs to the calling shard
+        // and resumes its consumer there
+        template<typename Functor>
+        Future<std::invoke_result_t<Functor, EventLoop &>> submit_to(std::size_t index, Functor &&fn) {
+            return local_shard().template call<std::invoke_result_t<Functor, EventLoop &>>(
+                *shards.at(index), std::forward<Functor>(fn)
+            );
+        }
+
+        // Runs all shards until none of them has tasks left and no message is in flight. With pinning, the shards
+        // start only once all of their threads are pinned; throws std::system_error if one of them cannot be.
+        void run();
+
+        template<typename Functor>
+        static void create_and_run(
+            Functor &&fn, std::size_t shards = std::thread::hardware_concurrency(), bool pin = true
+        ) {
+            ShardedEventLoop loop(shards, pin);
+            Coroutine<void()> cor = [&loop, fn = std::forward<Functor>(fn)]() -> void {
+                fn(loop);
+            };
+            loop.shard(0).add_coroutine(cor);
+            loop.run();
+        }
+
+    private:
+        class Shard final : public EventLoop {
+        public:
+            using Task = std::move_only_function<void()>;
+
+            Shard(ShardedEventLoop &owner, std::size_t index, std::size_t count, int cpu);
+
+            template<typename Ret, typename Functor>
+            Future<Ret> call(Shard &target, Functor &&fn) {
+                auto promise = make_promise<Ret>();
+                auto future = make_future(promise);
+
+                // The promise never leaves this shard, the target only carries a pointer to it back and forth
+                auto *slot = new Promise<Ret>(std::move(promise));
+                send(target, [this, &target, slot, fn = std::forward<Functor>(fn)]() mutable -> void {
+                    // An exception thrown by fn travels back like its result and is rethrown by the consumer
+                    target.spawn([this, &target, slot, fn = std::move(fn)]() mutable -> void {
+                        auto outcome = _impl::capture(fn, static_cast<EventLoop &>(target));
+                        target.send(*this, [slot, outcome = std::move(outcome)]() mutable -> void {
+                            settle(*slot, std::move(outcome));
+                            delete slot;
+                        });
+                    });
+                });
+                return future;
+            }
+
+            // Error number of pthread_setaffinity_np(), 0 on success
+            [[nodiscard]] int pin(std::jthread &thread) const;
+
+            void work();
+
+            void wake();
+
+            [[nodiscard]] std::size_t get_index() const;
+
+        protected:
+            [[nodiscard]] StackAllocator &get_stack_allocator() override;
+
+            void set_current_coroutine(FutureCoroutine *cor) override;
+
+            [[nodiscard]] FutureCoroutine *get_current_coroutine() const override;
+
+            void add_task(std::move_only_function<void()> fn, Clock::time_point when) override;
+
+            void add_task(std::move_only_function<void()> fn) override;
+
+            void add_task(_impl::TaskNode *task) override;
+
+            [[nodiscard]] _impl::TaskQueue *get_task_queue() override;
+
+            void expect_remote_task() override;
+
+            void add_remote_task(std::move_only_function<void()> fn) override;
+
+        private:
+            void check_thread() const;
+
+            void send(Shard &target, Task message);
+
+            void spawn(Task fn);
+
+            void receive();
+
+            void flush();
+
+            void wait();
+
+            ShardedEventLoop &owner;
+            const std::size_t index;
+            const int cpu;
+            bool busy = true;
+
+            StackPool stacks;
+            FutureCoroutine *cur = nullptr;
+            _impl::TaskQueue tasks;
+            std::unordered_map<std::uint64_t, std::unique_ptr<FutureCoroutine>> detached;
+            std::uint64_t next_detached = 0;
+
+            // inbox[i] is written by shard i only, overflow[i] holds messages for shard i while its ring is full
+            std::vector<std::unique_ptr<_impl::SpscRing<Task>>> inbox;
+            std::vector<std::deque<Task>> overflow;
+            // Tasks of threads outside the loop, such as the results of run_blocking(); its sleep announcement and
+            // eventfd also wake the shard for messages on the rings
+            _impl::RemoteTasks remote;
+        };
+
+        [[nodiscard]] Shard &local_shard() const;
+
+        void stop();
+
+        static thread_local Shard *current;
+
+        const bool pin;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::atomic<bool> running = false;
+        std::atomic<bool> stopping = false;
+        // Shards that still have tasks plus messages in flight; the loop is over once it drops to zero
+        std::atomic<std::size_t> active = 0;
+    };
+
+}
+
+#endif //SHARDED_H
@@ -0,0 +1,190 @@
+#ifndef STACK_H
+#define STACK_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace AIO {
+
+    static constexpr std::size_t DEFAULT_STACK_SIZE = 16 * 1024; // 16 KiB
+    static constexpr std::size_t MIN_STACK_SIZE = 4 * 1024; // 4 KiB
+
+    class StackAllocator {
+    public:
+        StackAllocator() = default;
+
+        StackAllocator(const StackAllocator &) = delete;
+        StackAllocator &operator=(const StackAllocator &) = delete;
+
+        [[nodiscard]] virtual void *allocate(std::size_t size) = 0;
+
+        virtual void deallocate(void *stack, std::size_t size) noexcept = 0;
+
+        virtual ~StackAllocator() = default;
+    };
+
+    // Plain heap stacks, memory is not zero-filled
+    class HeapStackAllocator final : public StackAllocator {
+    public:
+        HeapStackAllocator() = default;
+
+        [[nodiscard]] void *allocate(std::size_t size) override;
+
+        void deallocate(void *stack, std::size_t size) noexcept override;
+
+        static HeapStackAllocator &instance();
+    };
+
+    // Anonymous mappings rounded up to whole pages, with a PROT_NONE guard page below the stack
+    // so that an overflow faults immediately instead of corrupting neighbouring memory
+    class MmapStackAllocator final : public StackAllocator {
+    public:
+        MmapStackAllocator() = default;
+
+        [[nodiscard]] void *allocate(std::size_t size) override;
+
+        void deallocate(void *stack, std::size_t size) noexcept override;
+
+        static MmapStackAllocator &instance();
+    };
+
+    // Allocator of coroutines that are not given one: guarded mmap stacks, recycled through the calling thread's
+    // StackPool::local(), so that creating a coroutine does not cost a round of system calls
+    StackAllocator &default_stack_allocator();
+
+    // Caches released stacks of a single size in an intrusive free list.
+    // A pool is not synchronized: use one pool per thread, e.g. the one returned by StackPool::local().
+    class StackPool final : public StackAllocator {
+    public:
+        static constexpr std::size_t DEFAULT_LIMIT = 1024;
+
+        explicit StackPool(
+            std::size_t stack_size = DEFAULT_STACK_SIZE, std::size_t limit = DEFAULT_LIMIT,
+            StackAllocator &upstream = MmapStackAllocator::instance()
+        );
+
+        [[nodiscard]] void *allocate(std::size_t size) override;
+
+        void deallocate(void *stack, std::size_t size) noexcept override;
+
+        // Pre-warms the pool so that it caches at least `count` stacks (but no more than the limit)
+        void reserve(std::size_t count);
+
+        // Releases cached stacks back to the upstream allocator
+        void shrink(std::size_t count = 0);
+
+        void set_limit(std::size_t limit);
+
+        [[nodiscard]] std::size_t get_limit() const;
+
+        [[nodiscard]] std::size_t get_stack_size() const;
+
+        [[nodiscard]] std::size_t cached() const;
+
+        ~StackPool() override;
+
+        static StackPool &local();
+
+    private:
+        struct FreeNode {
+            FreeNode *next;
+        };
+
+        const std::size_t stack_size;
+        std::size_t limit;
+        StackAllocator &upstream;
+
+        FreeNode *head = nullptr;
+        std::size_t count = 0;
+    };
+
+    // Forwards to the StackPool::local() of whichever thread calls it. All those pools share the same upstream, so a
+    // stack may be released on another thread than the one that allocated it, e.g. by a migrated coroutine.
+    class LocalStackAllocator final : public StackAllocator {
+    public:
+        LocalStackAllocator() = default;
+
+        [[nodiscard]] void *allocate(std::size_t size) override;
+
+        void deallocate(void *stack, std::size_t size) noexcept override;
+
+        static LocalStackAllocator &instance();
+    };
+
+    // Reserves stacks in large MAP_NORESERVE chunks, so that the kernel commits physical pages only when they are
+    // touched; a deallocated stack gives its pages back with MADV_DONTNEED. There are no guard pages between the
+    // stacks: a chunk stays a single mapping no matter how many stacks it holds. Not synchronized, like StackPool.
+    class ReservedStackAllocator final : public StackAllocator {
+    public:
+        static constexpr std::size_t DEFAULT_RESERVATION = 256 * 1024; // 256 KiB
+        static constexpr std::size_t DEFAULT_CHUNK_STACKS = 1024;
+
+        explicit ReservedStackAllocator(
+            std::size_t reservation = DEFAULT_RESERVATION, std::size_t chunk_stacks = DEFAULT_CHUNK_STACKS
+        );
+
+        [[nodiscard]] void *allocate(std::size_t size) override;
+
+        void deallocate(void *stack, std::size_t size) noexcept override;
+
+        [[nodiscard]] std::size_t get_reservation() const;
+
+        ~ReservedStackAllocator() override;
+
+    private:
+        const std::size_t reservation;
+        const std::size_t chunk_stacks;
+
+        std::vector<void *> chunks;
+        std::vector<void *> free;
+    };
+
+    namespace _impl {
+
+        std::size_t page_size();
+
+        // Number of bytes of [memory, memory + size) that are backed by physical pages
+        std::size_t resident_size(const void *memory, std::size_t size);
+
+        class Stack {
+        public:
+            Stack(StackAllocator &allocator, const std::size_t size)
+                : allocator(&allocator), memory(allocator.allocate(size)), size(size) { }
+
+            Stack(const Stack &) = delete;
+
+            Stack(Stack &&other) noexcept
+                : allocator(other.allocator), memory(std::exchange(other.memory, nullptr)), size(other.size) { }
+
+            Stack &operator=(const Stack &) = delete;
+            Stack &operator=(Stack &&) = delete;
+
+            [[nodiscard]] void *get_memory() const {
+                return memory;
+            }
+
+            [[nodiscard]] std::size_t get_size() const {
+                return size;
+            }
+
+            [[nodiscard]] std::size_t get_resident_size() const {
+                return resident_size(memory, size);
+            }
+
+            ~Stack() {
+                if (memory)
+                    allocator->deallocate(memory, size);
+            }
+
+        private:
+            StackAllocator *allocator;
+            void *memory;
+            std::size_t size;
+        };
+
+    }
+
+}
+
+#endif //STACK_H
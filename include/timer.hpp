@@ -0,0 +1,377 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+
+namespace AIO {
+
+    // Monotonic clock driving all event loop timers, immune to wall clock adjustments
+    using Clock = std::chrono::steady_clock;
+
+    // How a loop blocks until its next timer when nothing else wakes it up
+    enum class WaitStrategy {
+        // Plain timed sleep or poll timeout, which the kernel may delay by the thread's timer slack
+        SLEEP,
+        // Absolute CLOCK_MONOTONIC timerfd, which is not subject to timer slack
+        TIMERFD,
+        // Sleep until SPIN_THRESHOLD before the deadline, then busy-poll; burns a core for microsecond accuracy
+        SPIN,
+    };
+
+    static constexpr std::chrono::microseconds SPIN_THRESHOLD { 50 };
+
+}
+
+namespace AIO::_impl {
+
+    // Intrusive task: whoever schedules it keeps it in place until it has run, so queueing it allocates nothing
+    struct TaskNode {
+        TaskNode *next = nullptr;
+        void (*run)(TaskNode *task) = nullptr;
+    };
+
+    // Intrusive FIFO of task nodes
+    class TaskList {
+    public:
+        void push(TaskNode *task) {
+            task->next = nullptr;
+            if (tail)
+                tail->next = task;
+            else
+                head = task;
+            tail = task;
+        }
+
+        // nullptr if the list is empty
+        TaskNode *pop() {
+            TaskNode *task = head;
+            if (task) {
+                head = task->next;
+                if (!head)
+                    tail = nullptr;
+            }
+            return task;
+        }
+
+        [[nodiscard]] TaskNode *back() const {
+            return tail;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return head == nullptr;
+        }
+
+    private:
+        TaskNode *head = nullptr;
+        TaskNode *tail = nullptr;
+    };
+
+    // Hierarchical timing wheel over 64-bit ticks: 11 levels of 64 slots cover the whole tick range, so there is
+    // no overflow list. Insertion and cancellation are O(1); a timer cascades down at most once per level.
+    class TimerWheel {
+    public:
+        struct Node {
+            Node *prev = nullptr;
+            Node *next = nullptr;
+            std::uint64_t expiry = 0;
+            std::uint8_t level = 0;
+            std::uint8_t slot = 0;
+            TaskNode *task = nullptr;
+        };
+
+        using Handle = Node *;
+
+        explicit TimerWheel(std::uint64_t now = 0);
+
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+        Handle insert(std::uint64_t expiry, TaskNode *task);
+
+        // The handle must belong to a timer that has not fired yet
+        void cancel(Handle handle);
+
+        // Moves the wheel to the given tick, appending the tasks of all expired timers to `expired`
+        void advance(std::uint64_t tick, TaskList &expired);
+
+        // Earliest tick at which advance() has work to do; it is never later than the earliest expiry
+        [[nodiscard]] std::optional<std::uint64_t> next_event() const;
+
+        [[nodiscard]] std::uint64_t get_now() const;
+
+        [[nodiscard]] std::size_t size() const;
+
+        [[nodiscard]] bool empty() const;
+
+    private:
+        static constexpr unsigned SLOT_BITS = 6;
+        static constexpr unsigned SLOTS = 1 << SLOT_BITS;
+        static constexpr unsigned LEVELS = (64 + SLOT_BITS - 1) / SLOT_BITS;
+
+        struct Level {
+            std::uint64_t occupied = 0;
+            std::array<Node *, SLOTS> slots { };
+        };
+
+        [[nodiscard]] std::optional<std::pair<std::uint64_t, unsigned>> next_slot() const;
+
+        void link(Node *node);
+
+        void unlink(Node *node);
+
+        Node *allocate();
+
+        void release(Node *node);
+
+        std::uint64_t now;
+        std::size_t count = 0;
+        std::array<Level, LEVELS> levels { };
+
+        std::deque<Node> nodes;
+        Node *free = nullptr;
+    };
+
+    // Scheduled tasks of an event loop: an intrusive FIFO of tasks that are ready to run and a timing wheel for the
+    // rest. Task functions are built right into fixed-size nodes of the queue's arena and go back to its free list
+    // once they have run, so a loop in a steady state does not allocate for scheduling.
+    class TaskQueue {
+    public:
+        using Handle = TimerWheel::Handle;
+
+        using Tick = std::chrono::microseconds;
+
+        // Functions up to this size are stored in the task node, larger ones on the heap
+        static constexpr std::size_t MAX_STORED_FUNCTOR_SIZE = 80;
+
+        TaskQueue();
+
+        TaskQueue(const TaskQueue &) = delete;
+        TaskQueue &operator=(const TaskQueue &) = delete;
+
+        template<typename Functor>
+        void post(Functor &&fn) {
+            ready.push(store(std::forward<Functor>(fn)));
+        }
+
+        void post(TaskNode *task);
+
+        // Tasks whose time has already passed become ready on the next collect()
+        template<typename Functor>
+        Handle schedule(Functor &&fn, const Clock::time_point when) {
+            return timers.insert(ceil_tick(when), store(std::forward<Functor>(fn)));
+        }
+
+        void cancel(Handle handle);
+
+        // Moves timers that have expired by `now` to the ready queue
+        void collect(Clock::time_point now);
+
+        // Runs the tasks that were ready when it was called; tasks posted meanwhile wait for the next call
+        void run_ready();
+
+        // Removes the oldest ready task for the caller to run elsewhere
+        std::move_only_function<void()> take();
+
+        [[nodiscard]] bool has_ready() const;
+
+        // Deadline to wait for when no task is ready; may come earlier than the first timer
+        [[nodiscard]] std::optional<Clock::time_point> next_deadline() const;
+
+        [[nodiscard]] bool empty() const;
+
+        ~TaskQueue();
+
+    private:
+        // Node of the arena; `call` and `extract` are null while it is free
+        struct StoredTask : TaskNode {
+            TaskQueue *queue = nullptr;
+            // Runs the stored function and destroys it
+            void (*call)(StoredTask *task) = nullptr;
+            // Moves the stored function out and destroys it
+            std::move_only_function<void()> (*extract)(StoredTask *task) = nullptr;
+            alignas(std::max_align_t) std::byte storage[MAX_STORED_FUNCTOR_SIZE];
+        };
+
+        template<typename Functor>
+        static void call_stored(StoredTask *task) {
+            auto *fn = std::launder(reinterpret_cast<Functor *>(task->storage));
+            (*fn)();
+            std::destroy_at(fn);
+        }
+
+        template<typename Functor>
+        static std::move_only_function<void()> extract_stored(StoredTask *task) {
+            auto *fn = std::launder(reinterpret_cast<Functor *>(task->storage));
+            std::move_only_function<void()> extracted(std::move(*fn));
+            std::destroy_at(fn);
+            return extracted;
+        }
+
+        template<typename Functor, typename FunctorDecay = std::decay_t<Functor> >
+        StoredTask *store(Functor &&fn) {
+            if constexpr (sizeof(FunctorDecay) <= MAX_STORED_FUNCTOR_SIZE &&
+                          alignof(FunctorDecay) <= alignof(std::max_align_t)) {
+                StoredTask *task = allocate();
+                ::new(task->storage) FunctorDecay(std::forward<Functor>(fn));
+                task->call = call_stored<FunctorDecay>;
+                task->extract = extract_stored<FunctorDecay>;
+                return task;
+            } else {
+                return store([box = std::make_unique<FunctorDecay>(std::forward<Functor>(fn))]() -> void {
+                    (*box)();
+                });
+            }
+        }
+
+        static std::uint64_t floor_tick(Clock::time_point when);
+
+        static std::uint64_t ceil_tick(Clock::time_point when);
+
+        static void run_stored(TaskNode *task);
+
+        StoredTask *allocate();
+
+        void release(StoredTask *task);
+
+        TaskList ready;
+        TimerWheel timers;
+
+        std::deque<StoredTask> arena;
+        TaskNode *free = nullptr;
+    };
+
+    // Lock-free multi-producer single-consumer inbox of tasks. Producers push onto a stack; the consumer takes the
+    // whole stack with one exchange and hands it to a task queue in posting order.
+    class TaskInbox {
+    public:
+        TaskInbox() = default;
+
+        TaskInbox(const TaskInbox &) = delete;
+        TaskInbox &operator=(const TaskInbox &) = delete;
+
+        // Any thread
+        void push(std::move_only_function<void()> fn);
+
+        // Consumer only; returns the number of tasks moved to `queue`
+        std::size_t drain(TaskQueue &queue);
+
+        [[nodiscard]] bool empty() const;
+
+        ~TaskInbox();
+
+    private:
+        struct Node {
+            Node *next;
+            std::move_only_function<void()> fn;
+        };
+
+        std::atomic<Node *> head = nullptr;
+    };
+
+    // Tasks that other threads hand to a single-threaded loop, which polls get_fd() while it sleeps. Threads only
+    // signal the descriptor when the loop has announced a sleep, so a busy loop takes their tasks without syscalls.
+    class RemoteTasks {
+    public:
+        RemoteTasks();
+
+        RemoteTasks(const RemoteTasks &) = delete;
+        RemoteTasks &operator=(const RemoteTasks &) = delete;
+
+        // Any thread
+        void post(std::move_only_function<void()> fn);
+
+        // Loop only; announces a task that another thread is going to add(), awaiting() holds until it arrives
+        void expect();
+
+        // Any thread; adds a task announced by expect()
+        void add(std::move_only_function<void()> fn);
+
+        // Any thread; interrupts the current or next sleep of the loop
+        void wake();
+
+        // Any thread, once it has published work that the loop checks between prepare_sleep() and its wait, such
+        // as a queue of its own: wakes the loop if it has announced a sleep
+        void notify();
+
+        // Loop only; moves the arrived tasks to `queue` and returns their number
+        std::size_t drain(TaskQueue &queue);
+
+        [[nodiscard]] bool empty() const;
+
+        [[nodiscard]] bool awaiting() const;
+
+        // Loop only, around its blocking wait: returns false if a task has arrived meanwhile, so the loop must
+        // not block; either way, finish_sleep() ends the announcement
+        bool prepare_sleep();
+
+        void finish_sleep();
+
+        // Consumes the signal reported by get_fd()
+        void acknowledge();
+
+        [[nodiscard]] int get_fd() const;
+
+        ~RemoteTasks();
+
+    private:
+        TaskInbox inbox;
+        int event_fd;
+        std::atomic<bool> sleeping = false;
+        std::size_t awaited = 0;
+    };
+
+    // Bounds the waits of a loop for its next deadline according to a wait strategy. Loops poll their descriptors
+    // for poll_timeout(); with TIMERFD they also poll get_fd(), which becomes readable once the deadline passed by
+    // arm() is reached.
+    class DeadlineTimer {
+    public:
+        explicit DeadlineTimer(WaitStrategy strategy = WaitStrategy::SLEEP);
+
+        DeadlineTimer(const DeadlineTimer &) = delete;
+        DeadlineTimer &operator=(const DeadlineTimer &) = delete;
+
+        // How long a loop polling descriptors may block for the deadline; nullopt means until get_fd() wakes it
+        [[nodiscard]] std::optional<Clock::duration> poll_timeout(Clock::time_point deadline);
+
+        // With SPIN, busy-waits out the rest of the deadline once a poll bounded by poll_timeout() has timed out,
+        // returning early as soon as interrupted() holds; the other strategies return right away
+        template<typename Predicate>
+        void spin_until(const Clock::time_point deadline, Predicate &&interrupted) const {
+            if (strategy != WaitStrategy::SPIN)
+                return;
+            while (Clock::now() < deadline && !interrupted()) {
+#if defined(__x86_64__)
+                __builtin_ia32_pause();
+#endif
+            }
+        }
+
+        // Timerfd of the TIMERFD strategy, -1 for the other strategies
+        [[nodiscard]] int get_fd() const;
+
+        void arm(Clock::time_point deadline);
+
+        // Consumes the expiration reported by get_fd()
+        void acknowledge();
+
+        ~DeadlineTimer();
+
+    private:
+        WaitStrategy strategy;
+        int timer_fd = -1;
+        std::optional<Clock::time_point> armed;
+    };
+
+}
+
+#endif //TIMER_H
@@ -0,0 +1,158 @@
+#ifndef URING_H
+#define URING_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <linux/time_types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "aio.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace AIO {
+
+    // Completion-based loop on top of io_uring. Operations only fill submission queue entries; all entries queued
+    // by coroutines during one loop tick are submitted together by a single io_uring_enter() call, which also waits
+    // for completions (bounded by the deadline of the earliest timed task) that are then reaped in bulk.
+    // Every operation resolves to the raw completion result: a non-negative value on success, -errno on failure.
+    // The ring wait already takes a nanosecond timeout, so the TIMERFD wait strategy behaves like SLEEP here;
+    // SPIN busy-waits the last SPIN_THRESHOLD on the completion queue without entering the kernel.
+    // While results of run_blocking() are pending, a read of an eventfd stays in the ring to wake the loop up.
+    class UringEventLoop final : public EventLoop {
+    public:
+        static constexpr unsigned DEFAULT_ENTRIES = 256;
+        static constexpr std::uint64_t CURRENT_POSITION = -1;
+
+        explicit UringEventLoop(unsigned entries = DEFAULT_ENTRIES, WaitStrategy strategy = WaitStrategy::SLEEP);
+
+        UringEventLoop(const UringEventLoop &) = delete;
+        UringEventLoop &operator=(const UringEventLoop &) = delete;
+
+        Future<int> read(int fd, void *buf, unsigned len, std::uint64_t offset = CURRENT_POSITION);
+
+        Future<int> write(int fd, const void *buf, unsigned len, std::uint64_t offset = CURRENT_POSITION);
+
+        Future<int> accept(int fd, sockaddr *addr = nullptr, socklen_t *addrlen = nullptr, int flags = 0);
+
+        Future<int> connect(int fd, const sockaddr *addr, socklen_t addrlen);
+
+        Future<int> fsync(int fd, bool datasync = false);
+
+        // Resolves to -ETIME once the duration elapses
+        Future<int> timeout(std::chrono::nanoseconds duration);
+
+        // Registers buffers with the kernel; reads and writes that fall inside one of them are then issued as
+        // fixed-buffer operations. Returns false if the kernel refuses the registration.
+        bool register_buffers(std::span<const iovec> buffers);
+
+        // Registers descriptors with the kernel; operations on them are then issued with fixed file indices.
+        // Returns false if the kernel refuses the registration.
+        bool register_files(std::span<const int> fds);
+
+        void run();
+
+        template<typename Functor>
+        static void create_and_run(Functor &&fn) {
+            UringEventLoop loop;
+            Coroutine<void()> cor = [&loop, fn = std::forward<Functor>(fn)]() -> void {
+                fn(loop);
+            };
+            loop.add_coroutine(cor);
+            loop.run();
+        }
+
+        ~UringEventLoop();
+
+    protected:
+        [[nodiscard]] StackAllocator &get_stack_allocator() override;
+
+        void set_current_coroutine(FutureCoroutine *cor) override;
+
+        [[nodiscard]] FutureCoroutine *get_current_coroutine() const override;
+
+        void add_task(std::move_only_function<void()> fn, Clock::time_point when) override;
+
+        void add_task(std::move_only_function<void()> fn) override;
+
+        void add_task(_impl::TaskNode *task) override;
+
+        [[nodiscard]] _impl::TaskQueue *get_task_queue() override;
+
+        void expect_remote_task() override;
+
+        void add_remote_task(std::move_only_function<void()> fn) override;
+
+    private:
+        // user_data of the read that waits on the descriptor of the remote tasks, it resolves no promise
+        static constexpr std::uint64_t REMOTE_WAKEUP = -1;
+
+        struct Operation {
+            std::optional<Promise<int>> promise;
+            __kernel_timespec timeout { };
+        };
+
+        // Next submission queue entry, flushing the queue first if it is full
+        io_uring_sqe *next_sqe(std::uint8_t opcode, int fd);
+
+        io_uring_sqe *prepare(std::uint8_t opcode, int fd, Promise<int> promise);
+
+        // Keeps a read of the remote tasks' eventfd in flight, so that the ring wait returns once one arrives
+        void watch_remote();
+
+        [[nodiscard]] int find_buffer(const void *buf, unsigned len) const;
+
+        void enter(unsigned min_complete, const __kernel_timespec *timeout);
+
+        void reap();
+
+        int ring_fd;
+        unsigned features = 0;
+
+        void *sq_mapping = nullptr;
+        std::size_t sq_mapping_size = 0;
+        void *cq_mapping = nullptr;
+        std::size_t cq_mapping_size = 0;
+        io_uring_sqe *sqes = nullptr;
+        std::size_t sqes_size = 0;
+
+        unsigned *sq_head = nullptr;
+        unsigned *sq_tail = nullptr;
+        unsigned sq_mask = 0;
+        unsigned sq_entries = 0;
+        unsigned sq_local_tail = 0;
+        unsigned sq_submitted = 0;
+
+        unsigned *cq_head = nullptr;
+        unsigned *cq_tail = nullptr;
+        unsigned cq_mask = 0;
+        io_uring_cqe *cqes = nullptr;
+
+        std::deque<Operation> operations;
+        std::vector<std::size_t> free_operations;
+        std::size_t in_flight = 0;
+
+        std::vector<iovec> fixed_buffers;
+        std::unordered_map<int, unsigned> fixed_files;
+
+        StackPool stacks;
+        FutureCoroutine *cur = nullptr;
+        _impl::TaskQueue tasks;
+        _impl::DeadlineTimer timer;
+
+        _impl::RemoteTasks remote;
+        bool watching_remote = false;
+        std::uint64_t remote_counter = 0;
+    };
+
+}
+
+#endif //URING_H
@@ -0,0 +1,248 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "aio.hpp"
+
+namespace AIO {
+
+    namespace _impl {
+
+        // Chase-Lev deque: the owner pushes and pops at the bottom, other threads steal from the top.
+        // Retired buffers are kept until destruction, since a thief may still be reading from one of them.
+        template<typename T>
+        class ChaseLevDeque {
+        public:
+            explicit ChaseLevDeque(std::size_t capacity = 256) {
+                buffers.push_back(std::make_unique<Buffer>(std::bit_ceil(capacity)));
+                buffer.store(buffers.back().get(), std::memory_order_relaxed);
+            }
+
+            ChaseLevDeque(const ChaseLevDeque &) = delete;
+            ChaseLevDeque &operator=(const ChaseLevDeque &) = delete;
+
+            // Owner only
+            void push(T *item) {
+                const std::int64_t b = bottom.load(std::memory_order_relaxed);
+                const std::int64_t t = top.load(std::memory_order_acquire);
+                Buffer *a = buffer.load(std::memory_order_relaxed);
+                if (b - t > static_cast<std::int64_t>(a->mask)) {
+                    buffers.push_back(std::make_unique<Buffer>((a->mask + 1) * 2));
+                    for (std::int64_t i = t; i < b; i++) {
+                        buffers.back()->put(i, a->get(i));
+                    }
+                    a = buffers.back().get();
+                    buffer.store(a, std::memory_order_release);
+                }
+                a->put(b, item);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            // Owner only, nullptr if the deque is empty
+            T *pop() {
+                const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+                Buffer *a = buffer.load(std::memory_order_relaxed);
+                bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                std::int64_t t = top.load(std::memory_order_relaxed);
+
+                if (t > b) {
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                T *item = a->get(b);
+                if (t == b) {
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                        item = nullptr;
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+                return item;
+            }
+
+            // Any thread, nullptr if the deque is empty or another thief took the item first
+            T *steal() {
+                std::int64_t t = top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const std::int64_t b = bottom.load(std::memory_order_acquire);
+                if (t >= b)
+                    return nullptr;
+
+                T *item = buffer.load(std::memory_order_acquire)->get(t);
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return nullptr;
+                return item;
+            }
+
+            [[nodiscard]] bool empty() const {
+                const std::int64_t t = top.load(std::memory_order_acquire);
+                const std::int64_t b = bottom.load(std::memory_order_acquire);
+                return t >= b;
+            }
+
+        private:
+            struct Buffer {
+                explicit Buffer(const std::size_t capacity)
+                    : mask(capacity - 1), slots(std::make_unique<std::atomic<T *>[]>(capacity)) {}
+
+                [[nodiscard]] T *get(const std::int64_t i) const {
+                    return slots[i & mask].load(std::memory_order_relaxed);
+                }
+
+                void put(const std::int64_t i, T *item) {
+                    slots[i & mask].store(item, std::memory_order_relaxed);
+                }
+
+                const std::size_t mask;
+                std::unique_ptr<std::atomic<T *>[]> slots;
+            };
+
+            alignas(64) std::atomic<std::int64_t> top = 0;
+            alignas(64) std::atomic<std::int64_t> bottom = 0;
+            std::atomic<Buffer *> buffer;
+            std::vector<std::unique_ptr<Buffer>> buffers;
+        };
+
+    }
+
+    // Runs tasks on a fixed set of worker threads. Every worker owns a Chase-Lev deque and steals from the others
+    // when it runs dry; timed tasks and tasks added from outside the workers go through a shared, locked queue.
+    // A coroutine suspended by Future::await() may be resumed on any worker, so it must not keep pointers to
+    // thread-local data across awaits. Tasks spawned by a running coroutine are published once it suspends or
+    // finishes; from then on their producers may run concurrently, so the Futures it holds must stay in place.
+    class WorkStealingEventLoop final : public EventLoop {
+    public:
+        explicit WorkStealingEventLoop(std::size_t workers = std::thread::hardware_concurrency());
+
+        WorkStealingEventLoop(const WorkStealingEventLoop &) = delete;
+        WorkStealingEventLoop &operator=(const WorkStealingEventLoop &) = delete;
+
+        // Runs until no tasks are left; the calling thread serves as the first worker
+        void run();
+
+        [[nodiscard]] std::size_t get_worker_count() const;
+
+        template<typename Functor>
+        static void create_and_run(Functor &&fn, std::size_t workers = std::thread::hardware_concurrency()) {
+            WorkStealingEventLoop loop(workers);
+            Coroutine<void()> cor = [&loop, fn = std::forward<Functor>(fn)]() -> void {
+                fn(loop);
+            };
+            loop.add_coroutine(cor);
+            loop.run();
+        }
+
+    protected:
+        [[nodiscard]] StackAllocator &get_stack_allocator() override;
+
+        void set_current_coroutine(FutureCoroutine *cor) override;
+
+        [[nodiscard]] FutureCoroutine *get_current_coroutine() const override;
+
+        void add_task(std::move_only_function<void()> fn, Clock::time_point when) override;
+
+        void add_task(std::move_only_function<void()> fn) override;
+
+        using EventLoop::add_task;
+
+        void expect_remote_task() override;
+
+        void add_remote_task(std::move_only_function<void()> fn) override;
+
+        void suspend(FutureCoroutine *cor, _impl::Rendezvous &rendezvous, _impl::TaskNode &wake) override;
+
+        void defer(std::move_only_function<void()> fn) override;
+
+    private:
+        using Task = std::move_only_function<void()>;
+
+        struct Spawned {
+            Task task;
+            std::optional<Clock::time_point> when;
+        };
+
+        struct Parking {
+            _impl::Rendezvous *rendezvous;
+            _impl::TaskNode *wake;
+        };
+
+        struct Worker;
+
+        // Node of a worker's pool that carries a ready task through the deques. A slot goes back to the pool of
+        // the worker it came from once its task has been taken out; a thief returns it through `returned`.
+        struct Slot {
+            Task task;
+            Worker *home;
+            Slot *next = nullptr;
+        };
+
+        struct Worker {
+            WorkStealingEventLoop *loop;
+            std::size_t index;
+            _impl::ChaseLevDeque<Slot> deque;
+            std::minstd_rand random;
+
+            std::deque<Slot> slots;
+            Slot *free = nullptr;
+            std::atomic<Slot *> returned = nullptr;
+
+            FutureCoroutine *cur = nullptr;
+            std::optional<Parking> parking;
+            std::vector<Spawned> spawned;
+            std::vector<Task> deferred;
+        };
+
+        [[nodiscard]] Worker *local_worker() const;
+
+        void work(Worker &worker);
+
+        void execute(Worker &worker, Task task);
+
+        void publish(Worker &worker);
+
+        Slot *steal(Worker &thief);
+
+        static Slot *acquire(Worker &worker, Task task);
+
+        // Takes the task out of a slot popped or stolen by worker and recycles the slot
+        static Task release(Worker &worker, Slot *slot);
+
+        [[nodiscard]] bool any_stealable() const;
+
+        void finish_task();
+
+        // Both expect the mutex to be held
+        void wake_for_task();
+
+        void wake_for_timer(Clock::time_point when);
+
+        static thread_local Worker *current_worker;
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<std::size_t> pending = 0;
+        std::atomic<std::size_t> idle = 0;
+
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable timekeeper_wakeup;
+        std::optional<Clock::time_point> timekeeper_deadline;
+        _impl::TaskQueue shared;
+        bool stopping = false;
+    };
+
+}
+
+#endif //WORK_STEALING_H
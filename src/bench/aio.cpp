@@ -0,0 +1,195 @@
+#include "bench.hpp"
+#include "aio.hpp"
+#include "epoll.hpp"
+#include "sharded.hpp"
+#include "work_stealing.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+    template<typename Loop>
+    void bench_lateness(const std::string &name, const AIO::WaitStrategy strategy) {
+        constexpr std::size_t N = 1000;
+        static constexpr std::chrono::microseconds DELAY { 100 };
+
+        Loop loop(strategy);
+        std::chrono::nanoseconds late { };
+        AIO::Coroutine<void()> cor = [&loop, &late] {
+            for (std::size_t i = 0; i < N; i++) {
+                const auto start = AIO::Clock::now();
+                loop.sleep(DELAY).await();
+                late += AIO::Clock::now() - start - DELAY;
+            }
+        };
+        loop.add_coroutine(cor);
+        loop.run();
+
+        report(name + " lateness per 100 us sleep", static_cast<double>(late.count()) / N / 1000, "us", N);
+    }
+
+}
+
+void bench_event_loop() {
+    report_section("Event loop");
+
+    constexpr std::size_t N = 1000000;
+    constexpr std::size_t BATCH = 1000;
+
+    AIO::SynchronousEventLoop::create_and_run([](AIO::EventLoop &loop) {
+        bench("async_call + await", N, [&loop] {
+            loop.async_call([] { return 0; }).await();
+        });
+
+        bench("async_call(NEVER_AWAITS) + await", N, [&loop] {
+            loop.async_call(AIO::NEVER_AWAITS, [] { return 0; }).await();
+        });
+
+        // Steady state: task nodes come from the loop's pool and the consumer is resumed through its future; the
+        // stackful call still allocates its coroutine
+        bench_allocations("heap allocations per async_call(NEVER_AWAITS) + await", N, [&loop] {
+            loop.async_call(AIO::NEVER_AWAITS, [] { return 0; }).await();
+        });
+        bench_allocations("heap allocations per async_call + await", N, [&loop] {
+            loop.async_call([] { return 0; }).await();
+        });
+        // Timed tasks are built into the same arena as ready ones
+        bench_allocations("heap allocations per sleep(0) + await", N, [&loop] {
+            loop.sleep(std::chrono::microseconds(0)).await();
+        });
+
+        std::vector<AIO::Future<int> > futures;
+        futures.reserve(BATCH);
+        bench("task throughput, batches of 1000 async_calls", N / BATCH, [&loop, &futures] {
+            for (std::size_t i = 0; i < BATCH; i++) {
+                futures.push_back(loop.async_call([] { return 0; }));
+            }
+            for (auto &future : futures) {
+                future.await();
+            }
+            futures.clear();
+        }, BATCH);
+
+        bench("task throughput, batches of 1000 async_calls, NEVER_AWAITS", N / BATCH, [&loop, &futures] {
+            for (std::size_t i = 0; i < BATCH; i++) {
+                futures.push_back(loop.async_call(AIO::NEVER_AWAITS, [] { return 0; }));
+            }
+            for (auto &future : futures) {
+                future.await();
+            }
+            futures.clear();
+        }, BATCH);
+    });
+
+    AIO::SynchronousEventLoop worker;
+    std::thread thread([&worker] {
+        worker.run_until_stopped();
+    });
+    AIO::SynchronousEventLoop::create_and_run([&worker](AIO::EventLoop &) {
+        bench("post_future to another thread + await", N / 10, [&worker] {
+            worker.post_future([] { return 0; }).await();
+        });
+    });
+    worker.stop();
+    thread.join();
+
+    AIO::SynchronousEventLoop::create_and_run([](AIO::EventLoop &loop) {
+        bench("run_blocking + await", N / 10, [&loop] {
+            loop.run_blocking([] { return 0; }).await();
+        });
+
+        // Twice as many calls as the pool may queue, the excess waits in the loop's backlog
+        AIO::BlockingPool pool(4, BATCH / 2);
+        std::vector<AIO::Future<int> > futures;
+        futures.reserve(BATCH);
+        bench("run_blocking throughput, batches of 1000 on a saturated pool", N / BATCH / 10, [&loop, &pool, &futures] {
+            for (std::size_t i = 0; i < BATCH; i++) {
+                futures.push_back(loop.run_blocking(pool, [] { return 0; }));
+            }
+            for (auto &future : futures) {
+                future.await();
+            }
+            futures.clear();
+        }, BATCH);
+    });
+}
+
+void bench_sleeps(const std::size_t count) {
+    report_section("Sleeps");
+
+    AIO::SynchronousEventLoop::create_and_run([count](AIO::EventLoop &loop) {
+        std::vector<AIO::Future<AIO::_impl::coroutine_void_t> > sleeps;
+        sleeps.reserve(count);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < count; i++) {
+            sleeps.push_back(loop.sleep(std::chrono::microseconds(i * 7919 % 500000)));
+        }
+        const auto scheduled = std::chrono::steady_clock::now();
+        for (auto &sleep : sleeps) {
+            sleep.await();
+        }
+        const auto finish = std::chrono::steady_clock::now();
+
+        report(
+            "concurrent sleeps up to 500 ms, scheduled",
+            std::chrono::duration<double, std::milli>(scheduled - start).count(), "ms", count
+        );
+        report(
+            "concurrent sleeps up to 500 ms, completed",
+            std::chrono::duration<double, std::milli>(finish - start).count(), "ms", count
+        );
+    });
+}
+
+void bench_timer_accuracy() {
+    report_section("Timer accuracy");
+
+    bench_lateness<AIO::SynchronousEventLoop>("synchronous, sleep", AIO::WaitStrategy::SLEEP);
+    bench_lateness<AIO::SynchronousEventLoop>("synchronous, timerfd", AIO::WaitStrategy::TIMERFD);
+    bench_lateness<AIO::SynchronousEventLoop>("synchronous, spin", AIO::WaitStrategy::SPIN);
+    bench_lateness<AIO::EpollEventLoop>("epoll, sleep", AIO::WaitStrategy::SLEEP);
+    bench_lateness<AIO::EpollEventLoop>("epoll, timerfd", AIO::WaitStrategy::TIMERFD);
+    bench_lateness<AIO::EpollEventLoop>("epoll, spin", AIO::WaitStrategy::SPIN);
+}
+
+void bench_work_stealing() {
+    report_section("Work stealing");
+
+    constexpr std::size_t N = 100000;
+    constexpr std::size_t FAN_OUT = 64;
+
+    AIO::WorkStealingEventLoop::create_and_run([](AIO::EventLoop &loop) {
+        bench("async_call + await", N, [&loop] {
+            loop.async_call([] { return 0; }).await();
+        });
+
+        bench("fan-out of 64 async_calls", N / FAN_OUT, [&loop] {
+            std::vector<AIO::Future<int> > futures;
+            futures.reserve(FAN_OUT);
+            for (std::size_t i = 0; i < FAN_OUT; i++) {
+                futures.push_back(loop.async_call([] { return 0; }));
+            }
+            for (auto &future : futures) {
+                future.await();
+            }
+        });
+    });
+}
+
+void bench_sharded() {
+    report_section("Shards");
+
+    constexpr std::size_t N = 100000;
+
+    AIO::ShardedEventLoop::create_and_run([](AIO::ShardedEventLoop &loop) {
+        bench("submit_to own shard + await", N, [&loop] {
+            loop.submit_to(0, [](AIO::EventLoop &) { return 0; }).await();
+        });
+
+        bench("submit_to other shard + await", N, [&loop] {
+            loop.submit_to(1, [](AIO::EventLoop &) { return 0; }).await();
+        });
+    }, 2);
+}
@@ -0,0 +1,47 @@
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions of the benchmark binary to count heap allocations
+
+namespace {
+
+    thread_local std::size_t allocations = 0;
+
+    void *counted_allocate(const std::size_t size) {
+        allocations++;
+        if (void *memory = std::malloc(size ? size : 1))
+            return memory;
+        throw std::bad_alloc();
+    }
+
+}
+
+std::size_t allocation_count() {
+    return allocations;
+}
+
+void *operator new(const std::size_t size) {
+    return counted_allocate(size);
+}
+
+void *operator new[](const std::size_t size) {
+    return counted_allocate(size);
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
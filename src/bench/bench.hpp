@@ -0,0 +1,68 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// Results are printed as they come, or collected into a single JSON document when JSON output is enabled
+void set_json_output(bool json);
+
+void report_section(const std::string &name);
+
+void report(const std::string &name, double value, const std::string &unit, std::size_t iterations = 0);
+
+void finish_report();
+
+// Heap allocations made so far by the calling thread through operator new
+std::size_t allocation_count();
+
+// Runs fun `iterations` times; each run performs `batch` operations, which the result is normalized to
+template<typename Functor>
+void bench(const std::string &name, const std::size_t iterations, Functor &&fun, const std::size_t batch = 1) {
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; i++) {
+        fun();
+    }
+    const auto finish = std::chrono::steady_clock::now();
+
+    const double ns = std::chrono::duration<double, std::nano>(finish - start).count();
+    report(name, ns / static_cast<double>(iterations * batch), "ns/op", iterations * batch);
+}
+
+// Runs fun like bench() does and reports how many heap allocations an operation makes on average
+template<typename Functor>
+void bench_allocations(const std::string &name, const std::size_t iterations, Functor &&fun) {
+    const std::size_t start = allocation_count();
+    for (std::size_t i = 0; i < iterations; i++) {
+        fun();
+    }
+    const std::size_t finish = allocation_count();
+
+    report(name, static_cast<double>(finish - start) / static_cast<double>(iterations), "allocs/op", iterations);
+}
+
+void bench_context_switch();
+
+void bench_coroutines();
+
+void bench_stack_pool();
+
+void bench_scale(std::size_t count);
+
+void bench_event_loop();
+
+void bench_sleeps(std::size_t count);
+
+void bench_timer_accuracy();
+
+void bench_work_stealing();
+
+void bench_sharded();
+
+void bench_echo(std::size_t connections);
+
+void bench_file_reads(std::size_t size);
+
+#endif //BENCH_H
@@ -0,0 +1,88 @@
+#include "bench.hpp"
+#include "context.hpp"
+#include "stack.hpp"
+
+#include <ucontext.h>
+#include <x86intrin.h>
+
+namespace {
+
+    AIO::aio_context aio_ctx { };
+
+    AIO::aio_context swap_main_ctx { }, swap_sub_ctx { };
+
+    AIO::aio_context inline_ctx { };
+
+    ucontext_t main_uctx { }, sub_uctx { };
+
+    // Like bench(), but in TSC cycles per switch, a round-trip being two switches
+    template<typename Functor>
+    void bench_cycles(const std::string &name, const std::size_t iterations, Functor &&fun) {
+        const std::uint64_t start = __rdtsc();
+        for (std::size_t i = 0; i < iterations; i++) {
+            fun();
+        }
+        const std::uint64_t finish = __rdtsc();
+
+        report(name, static_cast<double>(finish - start) / static_cast<double>(iterations * 2), "cycles", iterations);
+    }
+
+}
+
+void bench_context_switch() {
+    report_section("Context switch");
+
+    constexpr std::size_t N = 10000000;
+
+    AIO::_impl::Stack aio_stack(AIO::default_stack_allocator(), AIO::DEFAULT_STACK_SIZE);
+    aio_context_create(&aio_ctx, aio_stack.get_memory(), aio_stack.get_size(), [] {
+        while (true) {
+            aio_context_switch(&aio_ctx);
+        }
+    });
+    bench("aio_context_switch round-trip", N, [] {
+        aio_context_switch(&aio_ctx);
+    });
+    bench_cycles("aio_context_switch TSC cycles per switch", N, [] {
+        aio_context_switch(&aio_ctx);
+    });
+
+    AIO::_impl::Stack inline_stack(AIO::default_stack_allocator(), AIO::DEFAULT_STACK_SIZE);
+    aio_context_create(&inline_ctx, inline_stack.get_memory(), inline_stack.get_size(), [] {
+        while (true) {
+            aio_context_switch_inline(&inline_ctx);
+        }
+    });
+    bench("aio_context_switch_inline round-trip", N, [] {
+        aio_context_switch_inline(&inline_ctx);
+    });
+    bench_cycles("aio_context_switch_inline TSC cycles per switch", N, [] {
+        aio_context_switch_inline(&inline_ctx);
+    });
+
+    AIO::_impl::Stack swap_stack(AIO::default_stack_allocator(), AIO::DEFAULT_STACK_SIZE);
+    aio_context_create(&swap_sub_ctx, swap_stack.get_memory(), swap_stack.get_size(), [] {
+        while (true) {
+            aio_context_swap(&swap_sub_ctx, &swap_main_ctx);
+        }
+    });
+    bench("aio_context_swap round-trip", N, [] {
+        aio_context_swap(&swap_main_ctx, &swap_sub_ctx);
+    });
+    bench_cycles("aio_context_swap TSC cycles per switch", N, [] {
+        aio_context_swap(&swap_main_ctx, &swap_sub_ctx);
+    });
+
+    AIO::_impl::Stack ucontext_stack(AIO::default_stack_allocator(), AIO::DEFAULT_STACK_SIZE);
+    getcontext(&sub_uctx);
+    sub_uctx.uc_stack.ss_sp = ucontext_stack.get_memory();
+    sub_uctx.uc_stack.ss_size = ucontext_stack.get_size();
+    makecontext(&sub_uctx, [] {
+        while (true) {
+            swapcontext(&sub_uctx, &main_uctx);
+        }
+    }, 0);
+    bench("swapcontext round-trip", N, [] {
+        swapcontext(&main_uctx, &sub_uctx);
+    });
+}
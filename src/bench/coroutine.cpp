@@ -0,0 +1,188 @@
+#include "bench.hpp"
+#include "coroutine.hpp"
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    volatile int sink;
+
+}
+
+void bench_coroutines() {
+    report_section("Coroutines");
+
+    constexpr std::size_t N = 1000000;
+    constexpr std::size_t GENERATED = 1000;
+
+    AIO::StackPool &pool = AIO::StackPool::local();
+    pool.reserve(1);
+
+    bench("Coroutine<int()> create/resume/destroy, pooled stack", N, [&pool] {
+        AIO::Coroutine<int()> cor([] { return 1; }, pool);
+        sink = cor.resume();
+    });
+
+    // Too large for the small buffer of std::move_only_function, but it lives on the coroutine stack all the same
+    const std::array<int, 16> captures { };
+    bench("Coroutine<int()> create/resume/destroy, 64 bytes of captures", N, [&pool, &captures] {
+        AIO::Coroutine<int()> cor([captures] { return captures[0] + 1; }, pool);
+        sink = cor.resume();
+    });
+
+    AIO::Coroutine<int()> counter = [&counter] [[noreturn]] () -> int {
+        int i = 0;
+        while (true) {
+            counter.yield(i++);
+        }
+    };
+    bench("Coroutine<int()> resume/yield", N * 10, [&counter] {
+        sink = counter.resume();
+    });
+
+    // Producer -> transformer -> consumer: nested resumes take four switches per item, transfers take three
+    int value = 0;
+    AIO::Coroutine<void()> nested_producer = [&nested_producer, &value] [[noreturn]] {
+        while (true) {
+            value++;
+            nested_producer.yield();
+        }
+    };
+    AIO::Coroutine<void()> nested_transformer = [&nested_transformer, &nested_producer, &value] [[noreturn]] {
+        while (true) {
+            nested_producer.resume();
+            value *= 2;
+            nested_transformer.yield();
+        }
+    };
+    bench("3-stage pipeline, nested resume", N, [&nested_transformer, &value] {
+        nested_transformer.resume();
+        sink = value;
+    });
+
+    AIO::Coroutine<void()> transformer = [&transformer, &value] [[noreturn]] {
+        while (true) {
+            value *= 2;
+            transformer.yield();
+        }
+    };
+    AIO::Coroutine<void()> producer = [&producer, &transformer, &value] [[noreturn]] {
+        while (true) {
+            value++;
+            producer.transfer(transformer);
+        }
+    };
+    bench("3-stage pipeline, symmetric transfer", N, [&producer, &value] {
+        producer.resume();
+        sink = value;
+    });
+
+    bench("CoroutineGenerator iteration", N / GENERATED, [] {
+        AIO::Coroutine<int()> generator = [&generator] [[noreturn]] () -> int {
+            for (std::size_t i = 0; i < GENERATED; i++) {
+                generator.yield(static_cast<int>(i));
+            }
+            throw AIO::EndGeneration();
+        };
+        for (const int e : AIO::CoroutineGenerator(generator)) {
+            sink = e;
+        }
+    }, GENERATED);
+
+    bench("std::optional generator iteration", N / GENERATED, [] {
+        AIO::Coroutine<std::optional<int>()> generator = [&generator]() -> std::optional<int> {
+            for (std::size_t i = 0; i < GENERATED; i++) {
+                generator.yield(static_cast<int>(i));
+            }
+            return std::nullopt;
+        };
+        for (const int e : AIO::CoroutineGenerator(generator)) {
+            sink = e;
+        }
+    }, GENERATED);
+
+    bench("generator end by EndGeneration, pooled stack", N / 10, [&pool] {
+        AIO::Coroutine<int()> generator([] [[noreturn]] () -> int {
+            throw AIO::EndGeneration();
+        }, pool);
+        for (const int e : AIO::CoroutineGenerator(generator)) {
+            sink = e;
+        }
+    });
+
+    bench("generator end by std::nullopt, pooled stack", N / 10, [&pool] {
+        AIO::Coroutine<std::optional<int>()> generator([] { return std::optional<int>(); }, pool);
+        for (const int e : AIO::CoroutineGenerator(generator)) {
+            sink = e;
+        }
+    });
+
+    // Yielding large values: copies into the iterator, references into the generator, and spans of them
+    const std::string row(256, 'x');
+    bench("generator of std::string by value", N / GENERATED, [&pool, &row] {
+        AIO::Coroutine<std::string()> generator([&generator, &row] [[noreturn]] () -> std::string {
+            std::string current = row;
+            for (std::size_t i = 0; i < GENERATED; i++) {
+                current[0] = static_cast<char>(i);
+                generator.yield(current);
+            }
+            throw AIO::EndGeneration();
+        }, pool);
+        for (const std::string &e : AIO::CoroutineGenerator(generator)) {
+            sink = e[0];
+        }
+    }, GENERATED);
+
+    bench("generator of std::string by reference", N / GENERATED, [&pool, &row] {
+        AIO::Coroutine<std::string &()> generator([&generator, &row] [[noreturn]] () -> std::string & {
+            std::string current = row;
+            for (std::size_t i = 0; i < GENERATED; i++) {
+                current[0] = static_cast<char>(i);
+                generator.yield(current);
+            }
+            throw AIO::EndGeneration();
+        }, pool);
+        for (const std::string &e : AIO::CoroutineGenerator(generator)) {
+            sink = e[0];
+        }
+    }, GENERATED);
+
+    bench("generator of std::span<std::string>, 64 per yield", N / GENERATED, [&pool, &row] {
+        AIO::Coroutine<std::span<std::string>()> generator([&generator, &row]() -> std::span<std::string> {
+            std::vector<std::string> chunk(64, row);
+            for (std::size_t i = 0; i < GENERATED; i += chunk.size()) {
+                const std::size_t count = std::min(chunk.size(), GENERATED - i);
+                for (std::size_t j = 0; j < count; j++) {
+                    chunk[j][0] = static_cast<char>(i + j);
+                }
+                generator.yield(std::span(chunk.data(), count));
+            }
+            return { };
+        }, pool);
+        for (const std::string &e : AIO::CoroutineGenerator(generator)) {
+            sink = e[0];
+        }
+    }, GENERATED);
+
+    // filter | map | take over one generator: the stages add no stacks and no switches
+    bench("generator | filter | map | take", N / GENERATED, [&pool] {
+        AIO::Coroutine<std::optional<int>()> generator([&generator] [[noreturn]] () -> std::optional<int> {
+            for (int i = 0;; i++) {
+                generator.yield(i);
+            }
+        }, pool);
+        auto pipeline = generator
+            | AIO::views::filter([](const int e) { return e % 2 == 0; })
+            | AIO::views::map([](const int e) { return e * 3; })
+            | AIO::views::take(GENERATED);
+        for (const int e : pipeline) {
+            sink = e;
+        }
+    }, GENERATED);
+}
@@ -0,0 +1,110 @@
+#include "bench.hpp"
+#include "aio.hpp"
+#include "file.hpp"
+#include "uring.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+    std::size_t count_lines(const std::span<const std::byte> chunk) {
+        return std::count(chunk.begin(), chunk.end(), std::byte('\n'));
+    }
+
+    // Reads the file `rounds` times with read_lines, which returns the number of lines it saw
+    template<typename Functor>
+    void bench_throughput(const std::string &name, const std::size_t size, const std::size_t lines,
+                          const std::size_t rounds, Functor &&read_lines) {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < rounds; i++) {
+            if (read_lines() != lines) {
+                report(name + ", wrong line count", 0, "MB/s", 0);
+                return;
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report(name, static_cast<double>(size * rounds) / seconds / 1e6, "MB/s", rounds);
+    }
+
+}
+
+void bench_file_reads(const std::size_t size) {
+    report_section("File reads");
+
+    constexpr std::size_t ROUNDS = 10;
+    constexpr std::size_t LINE = 100;
+
+    char path[] = "/tmp/aio-bench-XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        report("temporary file could not be created", 0, "MB/s", 0);
+        return;
+    }
+    {
+        std::vector<char> line(LINE, 'x');
+        line.back() = '\n';
+        for (std::size_t written = 0; written < size; written += LINE) {
+            [[maybe_unused]] const auto result = write(fd, line.data(), line.size());
+        }
+        close(fd);
+    }
+    const std::size_t lines = (size + LINE - 1) / LINE;
+    const std::size_t file_size = lines * LINE;
+
+    // The page cache is warm for every mode, so the numbers compare the copying, not the disk
+    bench_throughput("whole file into a vector", file_size, lines, ROUNDS, [&path] {
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        std::vector<char> contents(stream.tellg());
+        stream.seekg(0);
+        stream.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+        return static_cast<std::size_t>(std::count(contents.begin(), contents.end(), '\n'));
+    });
+
+    bench_throughput("read_file", file_size, lines, ROUNDS, [&path] {
+        auto chunks = AIO::read_file(path);
+        std::size_t count = 0;
+        for (auto chunk = chunks.resume(); !chunk.empty(); chunk = chunks.resume()) {
+            count += count_lines(chunk);
+        }
+        return count;
+    });
+
+    bench_throughput("map_file", file_size, lines, ROUNDS, [&path] {
+        auto chunks = AIO::map_file(path);
+        std::size_t count = 0;
+        for (auto chunk = chunks.resume(); !chunk.empty(); chunk = chunks.resume()) {
+            count += count_lines(chunk);
+        }
+        return count;
+    });
+
+    bench_throughput("AsyncFileReader, blocking pool", file_size, lines, ROUNDS, [&path] {
+        std::size_t count = 0;
+        AIO::SynchronousEventLoop::create_and_run([&path, &count](AIO::EventLoop &loop) {
+            AIO::AsyncFileReader reader(loop, path);
+            for (auto chunk = reader.next().await(); !chunk.empty(); chunk = reader.next().await()) {
+                count += count_lines(chunk);
+            }
+        });
+        return count;
+    });
+
+    bench_throughput("AsyncFileReader, io_uring", file_size, lines, ROUNDS, [&path] {
+        std::size_t count = 0;
+        AIO::UringEventLoop::create_and_run([&path, &count](AIO::UringEventLoop &loop) {
+            AIO::AsyncFileReader reader(loop, path);
+            for (auto chunk = reader.next().await(); !chunk.empty(); chunk = reader.next().await()) {
+                count += count_lines(chunk);
+            }
+        });
+        return count;
+    });
+
+    unlink(path);
+}
@@ -0,0 +1,30 @@
+#include "bench.hpp"
+
+#include <cstring>
+#include <string>
+
+int main(const int argc, char *argv[]) {
+    bool json = false;
+    std::size_t scale_count = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0)
+            json = true;
+        else
+            scale_count = std::stoul(argv[i]);
+    }
+    set_json_output(json);
+
+    bench_context_switch();
+    bench_coroutines();
+    bench_stack_pool();
+    bench_event_loop();
+    bench_sleeps(1000000);
+    bench_timer_accuracy();
+    bench_work_stealing();
+    bench_sharded();
+    bench_scale(scale_count);
+    bench_echo(10000);
+    bench_file_reads(64 * 1024 * 1024);
+
+    finish_report();
+}
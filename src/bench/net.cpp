@@ -0,0 +1,104 @@
+#include "bench.hpp"
+#include "net.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/resource.h>
+
+void bench_echo(std::size_t connections) {
+    report_section("Echo");
+
+    constexpr std::size_t ROUNDS = 10;
+    constexpr std::size_t MESSAGE = 64;
+
+    // Both ends of every connection live in this process and must fit in its descriptor limit
+    rlimit limit { };
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        connections = std::min<std::size_t>(connections, (limit.rlim_cur - 64) / 2);
+    }
+
+    AIO::EpollEventLoop::create_and_run([connections](AIO::EpollEventLoop &loop) {
+        sockaddr_in address { };
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        AIO::TcpListener listener(loop, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+        address.sin_port = htons(listener.get_port());
+
+        std::vector<AIO::TcpStream> clients;
+        std::vector<AIO::TcpStream> servers;
+        clients.reserve(connections);
+        servers.reserve(connections);
+        for (std::size_t i = 0; i < connections; i++) {
+            auto client = AIO::TcpStream::open(loop);
+            auto connecting = client.connect(reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+            auto accepted = listener.accept().await();
+            if (connecting.await() != 0 || !accepted.has_value())
+                break;
+            client.set_nodelay(true);
+            accepted->set_nodelay(true);
+            clients.push_back(std::move(client));
+            servers.push_back(std::move(*accepted));
+        }
+
+        // Futures stay in place once their coroutines have started
+        std::vector<AIO::Future<int> > echoes;
+        echoes.reserve(servers.size());
+        for (auto &server : servers) {
+            echoes.push_back(loop.async_call([&server] {
+                std::array<std::byte, MESSAGE> buffer { };
+                while (true) {
+                    const ssize_t received = server.read(buffer).await();
+                    if (received <= 0)
+                        break;
+                    server.write(std::span(buffer.data(), received)).await();
+                }
+                return 0;
+            }));
+        }
+
+        std::vector<std::chrono::nanoseconds> latencies;
+        latencies.reserve(clients.size() * ROUNDS);
+        std::vector<AIO::Future<int> > requests;
+        requests.reserve(clients.size());
+
+        const auto start = AIO::Clock::now();
+        for (auto &client : clients) {
+            requests.push_back(loop.async_call([&client, &latencies] {
+                std::array<std::byte, MESSAGE> request { };
+                std::array<std::byte, MESSAGE> response { };
+                for (std::size_t round = 0; round < ROUNDS; round++) {
+                    const auto sent = AIO::Clock::now();
+                    client.write(request).await();
+                    client.read_exact(response).await();
+                    latencies.push_back(AIO::Clock::now() - sent);
+                }
+                client.shutdown_write();
+                return 0;
+            }));
+        }
+        for (auto &future : requests) {
+            future.await();
+        }
+        const auto elapsed = std::chrono::duration<double>(AIO::Clock::now() - start).count();
+        for (auto &future : echoes) {
+            future.await();
+        }
+
+        const std::string name = "loopback echo, " + std::to_string(clients.size()) + " connections";
+        const std::size_t count = latencies.size();
+        if (count == 0) {
+            report(name + ", no connection established", 0, "req/s", 0);
+            return;
+        }
+        std::ranges::sort(latencies);
+        const auto p99 = latencies[std::min(count - 1, count * 99 / 100)];
+        report(name + ", throughput", static_cast<double>(count) / elapsed, "req/s", count);
+        report(name + ", p99 latency", static_cast<double>(p99.count()) / 1000, "us", count);
+    });
+}
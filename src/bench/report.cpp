@@ -0,0 +1,92 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifndef AIO_BENCH_BUILD_TYPE
+#define AIO_BENCH_BUILD_TYPE ""
+#endif
+
+namespace {
+
+    struct Result {
+        std::string section;
+        std::string name;
+        double value;
+        std::string unit;
+        std::size_t iterations;
+    };
+
+    bool json_output = false;
+    std::string current_section;
+    std::vector<Result> results;
+
+    std::string quote(const std::string &text) {
+        std::string quoted = "\"";
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                quoted += ' ';
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
+    }
+
+    bool optimized() {
+#ifdef __OPTIMIZE__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+}
+
+void set_json_output(const bool json) {
+    json_output = json;
+    if (!optimized())
+        std::cerr << "warning: aio-bench is built without optimization, numbers are not representative" << std::endl;
+}
+
+void report_section(const std::string &name) {
+    current_section = name;
+    if (json_output)
+        return;
+
+    const std::size_t width = 30;
+    const std::size_t left = (width - std::min(width, name.size())) / 2;
+    std::cout << std::string(left, '-') << name << std::string(width - left - std::min(width, name.size()), '-')
+        << std::endl;
+}
+
+void report(const std::string &name, const double value, const std::string &unit, const std::size_t iterations) {
+    results.push_back({ current_section, name, value, unit, iterations });
+    if (json_output)
+        return;
+
+    std::cout << name << ": " << value << ' ' << unit;
+    if (unit == "ns/op")
+        std::cout << ", " << 1e9 / value << " op/s";
+    std::cout << std::endl;
+}
+
+void finish_report() {
+    if (!json_output)
+        return;
+
+    std::cout << "{\n";
+    std::cout << "  \"build\": {\"type\": " << quote(AIO_BENCH_BUILD_TYPE) << ", \"optimized\": "
+        << (optimized() ? "true" : "false") << ", \"compiler\": " << quote(__VERSION__) << "},\n";
+    std::cout << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result &result = results[i];
+        std::cout << (i ? ",\n    " : "\n    ") << "{\"section\": " << quote(result.section) << ", \"name\": "
+            << quote(result.name) << ", \"value\": " << result.value << ", \"unit\": " << quote(result.unit)
+            << ", \"iterations\": " << result.iterations << "}";
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+}
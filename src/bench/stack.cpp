@@ -0,0 +1,83 @@
+#include "bench.hpp"
+#include "coroutine.hpp"
+#include "stack.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+    std::size_t process_rss() {
+        std::size_t size = 0, resident = 0;
+        std::ifstream("/proc/self/statm") >> size >> resident;
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+
+}
+
+void bench_stack_pool() {
+    report_section("Stack pool");
+
+    constexpr std::size_t N = 1000000;
+
+    bench("coroutine create/destroy (heap)", N, [] {
+        AIO::Coroutine<void()> coro([] { }, AIO::HeapStackAllocator::instance());
+        coro.resume();
+    });
+
+    bench("coroutine create/destroy (mmap)", N, [] {
+        AIO::Coroutine<void()> coro([] { }, AIO::MmapStackAllocator::instance());
+        coro.resume();
+    });
+
+    bench("coroutine create/destroy (default)", N, [] {
+        AIO::Coroutine<void()> coro = [] { };
+        coro.resume();
+    });
+
+    AIO::StackPool &pool = AIO::StackPool::local();
+    pool.reserve(1);
+    bench("coroutine create/destroy (pool)", N, [&pool] {
+        AIO::Coroutine<void()> coro([] { }, pool);
+        coro.resume();
+    });
+}
+
+void bench_scale(const std::size_t count) {
+    report_section("Scale");
+
+    AIO::ReservedStackAllocator allocator;
+    const std::size_t reservation = allocator.get_reservation();
+    const std::size_t rss_before = process_rss();
+
+    std::vector<std::unique_ptr<AIO::Coroutine<void()> > > coros(count);
+    const auto start = std::chrono::steady_clock::now();
+    for (auto &coro : coros) {
+        coro = std::make_unique<AIO::Coroutine<void()> >([&coro] { coro->yield(); }, allocator, reservation);
+        coro->resume();
+    }
+    const auto finish = std::chrono::steady_clock::now();
+
+    const std::size_t rss_after = process_rss();
+    std::size_t stacks_resident = 0;
+    for (const auto &coro : coros) {
+        stacks_resident += coro->get_stack_resident_size();
+    }
+
+    report(
+        "create and resume with " + std::to_string(reservation / 1024) + " KiB reserved stacks",
+        std::chrono::duration<double, std::milli>(finish - start).count(), "ms", count
+    );
+    report(
+        "RSS growth per coroutine", static_cast<double>(rss_after - rss_before) / static_cast<double>(count), "bytes",
+        count
+    );
+    report(
+        "resident stack size per coroutine", static_cast<double>(stacks_resident) / static_cast<double>(count), "bytes",
+        count
+    );
+}
@@ -0,0 +1,80 @@
+#include "blocking.hpp"
+
+#include <algorithm>
+
+AIO::BlockingPool::BlockingPool(const std::size_t threads, const std::size_t queue_depth)
+    : queue_depth(std::max(queue_depth, std::size_t(1))) {
+    for (std::size_t i = 0; i < std::max(threads, std::size_t(1)); i++) {
+        this->threads.emplace_back([this]() -> void {
+            work();
+        });
+    }
+}
+
+bool AIO::BlockingPool::try_submit(std::move_only_function<void()> &&job) {
+    {
+        std::lock_guard lock(mutex);
+        if (jobs.size() >= queue_depth)
+            return false;
+        jobs.push_back(std::move(job));
+    }
+    wakeup.notify_one();
+    return true;
+}
+
+void AIO::BlockingPool::notify_when_free(std::move_only_function<void()> &&notify) {
+    {
+        std::lock_guard lock(mutex);
+        if (jobs.size() >= queue_depth) {
+            waiters.push_back(std::move(notify));
+            return;
+        }
+    }
+    notify();
+}
+
+std::size_t AIO::BlockingPool::get_thread_count() const {
+    return threads.size();
+}
+
+std::size_t AIO::BlockingPool::get_queue_depth() const {
+    return queue_depth;
+}
+
+AIO::BlockingPool &AIO::BlockingPool::instance() {
+    static BlockingPool pool;
+    return pool;
+}
+
+AIO::BlockingPool::~BlockingPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    threads.clear();
+}
+
+void AIO::BlockingPool::work() {
+    while (true) {
+        std::unique_lock lock(mutex);
+        wakeup.wait(lock, [this]() -> bool {
+            return stopping || !jobs.empty();
+        });
+        if (jobs.empty())
+            break;
+
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        std::move_only_function<void()> notify;
+        if (!waiters.empty()) {
+            notify = std::move(waiters.front());
+            waiters.pop_front();
+        }
+        lock.unlock();
+
+        if (notify)
+            notify();
+        job();
+    }
+}
@@ -0,0 +1,262 @@
+#include "epoll.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+AIO::EpollEventLoop::EpollEventLoop(const WaitStrategy strategy) : timer(strategy) {
+    // Created once the members are, since nothing closes it if their constructors throw
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        throw std::system_error(errno, std::generic_category(), "epoll_create1");
+
+    for (const int fd : { timer.get_fd(), remote.get_fd() }) {
+        if (fd < 0)
+            continue;
+
+        epoll_event event { };
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            const int error = errno;
+            close(epoll_fd);
+            throw std::system_error(error, std::generic_category(), "epoll_ctl");
+        }
+    }
+}
+
+AIO::Future<AIO::_impl::coroutine_void_t> AIO::EpollEventLoop::readable(const int fd) {
+    return wait(&Watch::readable, &Watch::reader, fd);
+}
+
+AIO::Future<AIO::_impl::coroutine_void_t> AIO::EpollEventLoop::writable(const int fd) {
+    return wait(&Watch::writable, &Watch::writer, fd);
+}
+
+AIO::Future<ssize_t> AIO::EpollEventLoop::perform(
+    const int fd, const bool write, std::move_only_function<ssize_t()> attempt
+) {
+    return perform(fd, write, std::move(attempt), [](const ssize_t result) -> ssize_t {
+        return result;
+    });
+}
+
+void AIO::EpollEventLoop::forget(const int fd) {
+    const auto it = watches.find(fd);
+    if (it == watches.end())
+        return;
+
+    const Watch &w = it->second;
+    if (w.reader.has_value() || w.writer.has_value() || w.read_operation.has_value() || w.write_operation.has_value())
+        assertion_failed("forgetting fd with pending waiters");
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    watches.erase(it);
+}
+
+void AIO::EpollEventLoop::run() {
+    while (true) {
+        remote.drain(tasks);
+        if (tasks.empty() && waiters == 0 && !remote.awaiting())
+            break;
+
+        std::optional<Clock::duration> timeout;
+        const auto deadline = tasks.next_deadline();
+        if (tasks.has_ready()) {
+            timeout = Clock::duration::zero();
+        } else if (deadline.has_value()) {
+            timeout = timer.poll_timeout(*deadline);
+        }
+
+        // SPIN has waited up to SPIN_THRESHOLD before the deadline; tasks from other threads end the spin like
+        // they end the wait, descriptor events are only seen once it is over
+        if (!dispatch(timeout) && !tasks.has_ready() && deadline.has_value()) {
+            timer.spin_until(*deadline, [this]() -> bool {
+                return !remote.empty();
+            });
+        }
+
+        tasks.collect(Clock::now());
+        tasks.run_ready();
+    }
+}
+
+AIO::EpollEventLoop::~EpollEventLoop() {
+    close(epoll_fd);
+}
+
+AIO::StackAllocator &AIO::EpollEventLoop::get_stack_allocator() {
+    return stacks;
+}
+
+void AIO::EpollEventLoop::set_current_coroutine(FutureCoroutine *cor) {
+    cur = cor;
+}
+
+AIO::EventLoop::FutureCoroutine *AIO::EpollEventLoop::get_current_coroutine() const {
+    return cur;
+}
+
+void AIO::EpollEventLoop::add_task(
+    std::move_only_function<void()> fn, const Clock::time_point when
+) {
+    tasks.schedule(std::move(fn), when);
+}
+
+void AIO::EpollEventLoop::add_task(std::move_only_function<void()> fn) {
+    tasks.post(std::move(fn));
+}
+
+void AIO::EpollEventLoop::add_task(_impl::TaskNode *task) {
+    tasks.post(task);
+}
+
+AIO::_impl::TaskQueue *AIO::EpollEventLoop::get_task_queue() {
+    return &tasks;
+}
+
+void AIO::EpollEventLoop::expect_remote_task() {
+    remote.expect();
+}
+
+void AIO::EpollEventLoop::add_remote_task(std::move_only_function<void()> fn) {
+    remote.add(std::move(fn));
+}
+
+AIO::EpollEventLoop::Watch &AIO::EpollEventLoop::watch(const int fd) {
+    const auto [it, inserted] = watches.try_emplace(fd);
+    if (inserted) {
+        epoll_event event { };
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            watches.erase(it);
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+        }
+    }
+    return it->second;
+}
+
+void AIO::EpollEventLoop::start(
+    const int fd, const bool write, std::move_only_function<ssize_t()> attempt,
+    std::move_only_function<void(ssize_t)> complete
+) {
+    Watch &w = watch(fd);
+    std::optional<Operation> &operation = write ? w.write_operation : w.read_operation;
+    if (operation.has_value())
+        assertion_failed("fd already has an operation in this direction");
+
+    const ssize_t result = attempt();
+    if (result != -EAGAIN) {
+        complete(result);
+        return;
+    }
+
+    // Readiness reported so far has been used up by the attempt, only a new edge may let it progress
+    (write ? w.writable : w.readable) = false;
+    operation.emplace(Operation { std::move(attempt), std::move(complete) });
+    waiters++;
+}
+
+AIO::Future<AIO::_impl::coroutine_void_t> AIO::EpollEventLoop::wait(
+    bool Watch::*ready, std::optional<EventPromise> Watch::*waiter, const int fd
+) {
+    Watch &w = watch(fd);
+    if ((w.*waiter).has_value())
+        assertion_failed("fd is already awaited in this direction");
+
+    auto promise = make_promise<_impl::coroutine_void_t>();
+    auto future = make_future(promise, []() -> _impl::coroutine_void_t { return {}; });
+    if (w.*ready) {
+        w.*ready = false;
+        resolve(promise);
+    } else {
+        w.*waiter = std::move(promise);
+        waiters++;
+    }
+    return future;
+}
+
+bool AIO::EpollEventLoop::dispatch(const std::optional<Clock::duration> timeout) {
+    epoll_event events[MAX_EVENTS];
+
+    timespec ts { };
+    if (timeout.has_value()) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(*timeout).count();
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+    }
+
+    // A task that arrived from another thread since the loop drained them must not wait for the timeout
+    const bool sleep = remote.prepare_sleep();
+    if (!sleep)
+        ts = { };
+    const int count = epoll_pwait2(
+        epoll_fd, events, MAX_EVENTS, timeout.has_value() || !sleep ? &ts : nullptr, nullptr
+    );
+    remote.finish_sleep();
+    if (count < 0) {
+        if (errno == EINTR)
+            return true;
+        throw std::system_error(errno, std::generic_category(), "epoll_wait");
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.fd == timer.get_fd()) {
+            timer.acknowledge();
+            continue;
+        }
+        if (events[i].data.fd == remote.get_fd()) {
+            remote.acknowledge();
+            continue;
+        }
+
+        const auto it = watches.find(events[i].data.fd);
+        if (it == watches.end())
+            continue;
+        Watch &w = it->second;
+
+        const std::uint32_t flags = events[i].events;
+        if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            w.readable = true;
+        if (flags & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            w.writable = true;
+
+        for (auto [ready, waiter] : {
+                 std::pair(&Watch::readable, &Watch::reader), std::pair(&Watch::writable, &Watch::writer)
+             }) {
+            if (!(w.*ready) || !(w.*waiter).has_value())
+                continue;
+
+            const EventPromise promise = std::move(*(w.*waiter));
+            (w.*waiter).reset();
+            w.*ready = false;
+            waiters--;
+            resolve(promise);
+        }
+
+        for (auto [ready, operation] : {
+                 std::pair(&Watch::readable, &Watch::read_operation),
+                 std::pair(&Watch::writable, &Watch::write_operation)
+             }) {
+            if (!(w.*ready) || !(w.*operation).has_value())
+                continue;
+
+            w.*ready = false;
+            const ssize_t result = (w.*operation)->attempt();
+            if (result == -EAGAIN)
+                continue;
+
+            auto complete = std::move((w.*operation)->complete);
+            (w.*operation).reset();
+            waiters--;
+            complete(result);
+        }
+    }
+
+    return count > 0;
+}
@@ -0,0 +1,263 @@
+#include "file.hpp"
+#include "uring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    // Descriptor owned by a generator, closed when the generator finishes or is destroyed
+    class FileDescriptor {
+    public:
+        explicit FileDescriptor(const std::string &path) : fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), "open");
+        }
+
+        FileDescriptor(FileDescriptor &&other) noexcept : fd(std::exchange(other.fd, -1)) {
+        }
+
+        FileDescriptor &operator=(FileDescriptor &&) = delete;
+
+        [[nodiscard]] int get() const {
+            return fd;
+        }
+
+        ~FileDescriptor() {
+            if (fd >= 0)
+                close(fd);
+        }
+
+    private:
+        int fd;
+    };
+
+    class Mapping {
+    public:
+        Mapping(const void *data, const std::size_t size) : data(data), size(size) {
+        }
+
+        Mapping(Mapping &&other) noexcept : data(std::exchange(other.data, nullptr)), size(other.size) {
+        }
+
+        Mapping &operator=(Mapping &&) = delete;
+
+        [[nodiscard]] const std::byte *get() const {
+            return static_cast<const std::byte *>(data);
+        }
+
+        ~Mapping() {
+            if (data)
+                munmap(const_cast<void *>(data), size);
+        }
+
+    private:
+        const void *data;
+        std::size_t size;
+    };
+
+    // A single read of the ring is limited to the range of its length field
+    unsigned read_length(const std::size_t size) {
+        return static_cast<unsigned>(std::min<std::size_t>(size, std::numeric_limits<unsigned>::max()));
+    }
+
+    // Read position after which the next readahead request is due: halfway through the window requested last
+    struct Readahead {
+        std::size_t window;
+        std::size_t requested = 0;
+
+        [[nodiscard]] bool due(const std::size_t position) const {
+            return window > 0 && position + window / 2 >= requested;
+        }
+    };
+
+}
+
+AIO::FileChunks AIO::read_file(const std::string &path, std::size_t chunk_size, const std::size_t readahead) {
+    chunk_size = std::max(chunk_size, std::size_t(1));
+    FileDescriptor file(path);
+    posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return FileChunks([file = std::move(file), chunk_size, readahead]() -> std::span<const std::byte> {
+        const auto buffer = std::make_unique<std::byte[]>(chunk_size);
+        Readahead ahead { readahead };
+        std::size_t position = 0;
+
+        auto *self = static_cast<FileChunks *>(_impl::current_coroutine);
+        while (true) {
+            if (ahead.due(position)) {
+                posix_fadvise(file.get(), static_cast<off_t>(position), static_cast<off_t>(readahead),
+                              POSIX_FADV_WILLNEED);
+                ahead.requested = position + readahead;
+            }
+
+            // Short reads are topped up, so that every chunk but the last one is full
+            std::size_t filled = 0;
+            while (filled < chunk_size) {
+                const ssize_t count = read(file.get(), buffer.get() + filled, chunk_size - filled);
+                if (count < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::system_error(errno, std::generic_category(), "read");
+                }
+                if (count == 0)
+                    break;
+                filled += count;
+            }
+            if (filled == 0)
+                return { };
+
+            position += filled;
+            self->yield(std::span<const std::byte>(buffer.get(), filled));
+        }
+    });
+}
+
+AIO::FileChunks AIO::map_file(const std::string &path, std::size_t chunk_size, const std::size_t readahead) {
+    chunk_size = std::max(chunk_size, std::size_t(1));
+    const FileDescriptor file(path);
+
+    struct stat status { };
+    if (fstat(file.get(), &status) != 0)
+        throw std::system_error(errno, std::generic_category(), "fstat");
+    const auto size = static_cast<std::size_t>(status.st_size);
+
+    // An empty file cannot be mapped, it makes a generator that ends right away
+    void *data = nullptr;
+    if (size > 0) {
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.get(), 0);
+        if (data == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+    Mapping mapping(data, size);
+
+    return FileChunks([mapping = std::move(mapping), size, chunk_size, readahead]() -> std::span<const std::byte> {
+        Readahead ahead { readahead };
+
+        auto *self = static_cast<FileChunks *>(_impl::current_coroutine);
+        for (std::size_t position = 0; position < size; position += chunk_size) {
+            if (ahead.due(position)) {
+                // madvise() takes page-aligned addresses, and the mapping itself is page-aligned
+                const std::size_t page = sysconf(_SC_PAGESIZE);
+                const std::size_t start = position / page * page;
+                madvise(const_cast<std::byte *>(mapping.get()) + start, std::min(readahead, size - start),
+                        MADV_WILLNEED);
+                ahead.requested = position + readahead;
+            }
+
+            self->yield(std::span(mapping.get() + position, std::min(chunk_size, size - position)));
+        }
+        return { };
+    });
+}
+
+AIO::AsyncFileReader::AsyncFileReader(
+    EventLoop &loop, const std::string &path, const std::size_t chunk_size, BlockingPool &pool
+) : AsyncFileReader(loop, nullptr, &pool, path, chunk_size) {
+}
+
+AIO::AsyncFileReader::AsyncFileReader(UringEventLoop &loop, const std::string &path, const std::size_t chunk_size)
+    : AsyncFileReader(loop, &loop, nullptr, path, chunk_size) {
+}
+
+AIO::AsyncFileReader::AsyncFileReader(
+    EventLoop &loop, UringEventLoop *ring, BlockingPool *pool, const std::string &path, const std::size_t chunk_size
+) : loop(loop), ring(ring), pool(pool), fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+    chunk_size(std::max(chunk_size, std::size_t(1))) {
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open");
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    buffers[0] = std::make_unique<std::byte[]>(this->chunk_size);
+    buffers[1] = std::make_unique<std::byte[]>(this->chunk_size);
+    prefetch();
+}
+
+AIO::Future<std::span<const std::byte>> AIO::AsyncFileReader::next() {
+    return loop.async_call([this]() -> std::span<const std::byte> {
+        if (!pending.has_value() && !reading.has_value())
+            return { };
+
+        const ssize_t count = collect();
+        if (count <= 0) {
+            error = static_cast<int>(-count);
+            return { };
+        }
+
+        const std::byte *chunk = buffers[filling].get();
+        filling ^= 1;
+        offset += count;
+        prefetch();
+        return { chunk, static_cast<std::size_t>(count) };
+    });
+}
+
+int AIO::AsyncFileReader::get_error() const {
+    return error;
+}
+
+AIO::AsyncFileReader::~AsyncFileReader() {
+    if (pending.has_value())
+        pending->await();
+    if (reading.has_value())
+        reading->await();
+    close(fd);
+}
+
+void AIO::AsyncFileReader::prefetch() {
+    std::byte *buffer = buffers[filling].get();
+    if (ring) {
+        reading.emplace(ring->read(fd, buffer, read_length(chunk_size), offset));
+        return;
+    }
+
+    pending.emplace(loop.run_blocking(*pool, [fd = fd, buffer, size = chunk_size, position = offset]() -> ssize_t {
+        // Short reads are topped up, so that only the last chunk may come out short
+        std::size_t filled = 0;
+        while (filled < size) {
+            const ssize_t count = pread(fd, buffer + filled, size - filled, position + static_cast<off_t>(filled));
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -errno;
+            }
+            if (count == 0)
+                break;
+            filled += count;
+        }
+        return static_cast<ssize_t>(filled);
+    }));
+}
+
+ssize_t AIO::AsyncFileReader::collect() {
+    if (!ring) {
+        const ssize_t count = pending->await();
+        pending.reset();
+        return count;
+    }
+
+    // Like the pool's reads, short reads of the ring are topped up, so that only the last chunk may come out short
+    std::byte *buffer = buffers[filling].get();
+    std::size_t filled = 0;
+    int count = reading->await();
+    reading.reset();
+    while (count > 0 || count == -EINTR) {
+        if (count > 0)
+            filled += count;
+        if (filled == chunk_size)
+            break;
+        count = ring->read(fd, buffer + filled, read_length(chunk_size - filled), offset + filled).await();
+    }
+    if (count < 0)
+        return count;
+    return static_cast<ssize_t>(filled);
+}
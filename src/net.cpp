@@ -0,0 +1,318 @@
+#include "net.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    ssize_t result_of(const ssize_t result) {
+        return result < 0 ? -errno : result;
+    }
+
+    // Result of a transfer that failed after moving `done` bytes: the short count if there is one, so the caller
+    // learns how much got through, -errno otherwise. EAGAIN keeps the operation waiting either way.
+    ssize_t partial_result(const std::size_t done) {
+        if (errno == EAGAIN || done == 0)
+            return -errno;
+        return static_cast<ssize_t>(done);
+    }
+
+    int checked(const int result, const char *what) {
+        if (result < 0)
+            throw std::system_error(errno, std::generic_category(), what);
+        return result;
+    }
+
+    // Pipe that send_file() splices through, closed along with the operation
+    struct SplicePipe {
+        int read_fd = -1;
+        int write_fd = -1;
+        std::size_t buffered = 0;
+
+        SplicePipe() = default;
+
+        SplicePipe(const SplicePipe &) = delete;
+        SplicePipe &operator=(const SplicePipe &) = delete;
+
+        ~SplicePipe() {
+            if (read_fd >= 0) {
+                ::close(read_fd);
+                ::close(write_fd);
+            }
+        }
+    };
+
+    constexpr std::size_t SPLICE_CHUNK = 64 * 1024;
+
+}
+
+AIO::Stream::Stream(EpollEventLoop &loop, const int fd) : loop(&loop), fd(fd) {
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && !(flags & O_NONBLOCK))
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+AIO::Stream::Stream(Stream &&other) noexcept : loop(other.loop), fd(std::exchange(other.fd, -1)) {
+}
+
+AIO::Stream &AIO::Stream::operator=(Stream &&other) noexcept {
+    if (this != &other) {
+        close();
+        loop = other.loop;
+        fd = std::exchange(other.fd, -1);
+    }
+    return *this;
+}
+
+AIO::Future<ssize_t> AIO::Stream::read(std::span<std::byte> buffer) {
+    return loop->perform(fd, false, [fd = fd, buffer]() -> ssize_t {
+        return result_of(::recv(fd, buffer.data(), buffer.size(), 0));
+    });
+}
+
+AIO::Future<ssize_t> AIO::Stream::read_exact(std::span<std::byte> buffer) {
+    return loop->perform(fd, false, [fd = fd, buffer, done = std::size_t(0)]() mutable -> ssize_t {
+        while (done < buffer.size()) {
+            const ssize_t received = ::recv(fd, buffer.data() + done, buffer.size() - done, 0);
+            if (received < 0)
+                return partial_result(done);
+            if (received == 0)
+                break;
+            done += received;
+        }
+        return static_cast<ssize_t>(done);
+    });
+}
+
+AIO::Future<ssize_t> AIO::Stream::write(std::span<const std::byte> buffer) {
+    return loop->perform(fd, true, [fd = fd, buffer, done = std::size_t(0)]() mutable -> ssize_t {
+        while (done < buffer.size()) {
+            const ssize_t sent = ::send(fd, buffer.data() + done, buffer.size() - done, MSG_NOSIGNAL);
+            if (sent < 0)
+                return partial_result(done);
+            done += sent;
+        }
+        return static_cast<ssize_t>(done);
+    });
+}
+
+AIO::Future<ssize_t> AIO::Stream::writev(std::span<const iovec> buffers) {
+    // The copy is advanced past whatever a partial write has sent
+    std::vector<iovec> pending(buffers.begin(), buffers.end());
+    return loop->perform(fd, true, [fd = fd, pending = std::move(pending), first = std::size_t(0),
+                                    done = std::size_t(0)]() mutable -> ssize_t {
+        while (first < pending.size()) {
+            msghdr message { };
+            message.msg_iov = pending.data() + first;
+            message.msg_iovlen = std::min(pending.size() - first, std::size_t(IOV_MAX));
+            ssize_t sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+            if (sent < 0)
+                return partial_result(done);
+            done += sent;
+
+            while (first < pending.size() && static_cast<std::size_t>(sent) >= pending[first].iov_len) {
+                sent -= static_cast<ssize_t>(pending[first].iov_len);
+                first++;
+            }
+            if (first < pending.size()) {
+                pending[first].iov_base = static_cast<std::byte *>(pending[first].iov_base) + sent;
+                pending[first].iov_len -= sent;
+            }
+        }
+        return static_cast<ssize_t>(done);
+    });
+}
+
+AIO::Future<ssize_t> AIO::Stream::send_file(const int file_fd, off_t offset, const std::size_t count) {
+    return loop->perform(fd, true, [fd = fd, file_fd, offset, count, done = std::size_t(0),
+                                    pipe = std::unique_ptr<SplicePipe>()]() mutable -> ssize_t {
+        while (!pipe && done < count) {
+            const ssize_t sent = ::sendfile(fd, file_fd, &offset, count - done);
+            if (sent == 0)
+                return static_cast<ssize_t>(done);
+            if (sent > 0) {
+                done += sent;
+                continue;
+            }
+            if (done > 0 || (errno != EINVAL && errno != ENOSYS))
+                return partial_result(done);
+
+            pipe = std::make_unique<SplicePipe>();
+            int fds[2];
+            if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
+                return -errno;
+            pipe->read_fd = fds[0];
+            pipe->write_fd = fds[1];
+        }
+
+        while (pipe && (done < count || pipe->buffered > 0)) {
+            if (pipe->buffered == 0) {
+                const ssize_t filled = ::splice(
+                    file_fd, &offset, pipe->write_fd, nullptr, std::min(count - done, SPLICE_CHUNK),
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+                );
+                // The pipe is empty at this point, so it cannot refuse the data for being full
+                if (filled < 0)
+                    return done > 0 ? static_cast<ssize_t>(done) : errno == EAGAIN ? -EIO : -errno;
+                if (filled == 0)
+                    break;
+                pipe->buffered = filled;
+                done += filled;
+            }
+
+            const ssize_t drained = ::splice(
+                pipe->read_fd, nullptr, fd, nullptr, pipe->buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+            );
+            if (drained < 0)
+                return partial_result(done - pipe->buffered);
+            pipe->buffered -= drained;
+        }
+        return static_cast<ssize_t>(done - (pipe ? pipe->buffered : 0));
+    });
+}
+
+void AIO::Stream::shutdown_write() {
+    ::shutdown(fd, SHUT_WR);
+}
+
+int AIO::Stream::get_fd() const {
+    return fd;
+}
+
+AIO::Stream::~Stream() {
+    close();
+}
+
+void AIO::Stream::close() {
+    if (fd < 0)
+        return;
+    loop->forget(fd);
+    ::close(fd);
+    fd = -1;
+}
+
+AIO::TcpStream AIO::TcpStream::open(EpollEventLoop &loop, const int family) {
+    return { loop, checked(socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket") };
+}
+
+AIO::Future<ssize_t> AIO::TcpStream::connect(const sockaddr *address, const socklen_t length) {
+    sockaddr_storage target { };
+    std::memcpy(&target, address, std::min(static_cast<std::size_t>(length), sizeof(target)));
+    return loop->perform(fd, true, [fd = fd, target, length, started = false]() mutable -> ssize_t {
+        if (!started) {
+            started = true;
+            if (::connect(fd, reinterpret_cast<const sockaddr *>(&target), length) == 0)
+                return 0;
+            // EAGAIN means that no local port is left, which waiting would not fix
+            if (errno == EAGAIN)
+                return -EADDRNOTAVAIL;
+            return errno == EINPROGRESS ? -EAGAIN : -errno;
+        }
+
+        // Writability ends a connection attempt, its outcome is kept as the socket error
+        int error = 0;
+        socklen_t size = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0)
+            return -errno;
+        return -error;
+    });
+}
+
+void AIO::TcpStream::set_nodelay(const bool nodelay) {
+    const int value = nodelay;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+}
+
+AIO::UnixStream AIO::UnixStream::open(EpollEventLoop &loop) {
+    return { loop, checked(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket") };
+}
+
+std::pair<AIO::UnixStream, AIO::UnixStream> AIO::UnixStream::pair(EpollEventLoop &loop) {
+    int fds[2];
+    checked(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds), "socketpair");
+    return { UnixStream(loop, fds[0]), UnixStream(loop, fds[1]) };
+}
+
+AIO::Future<ssize_t> AIO::UnixStream::connect(const std::string &path) {
+    sockaddr_un target { };
+    target.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(target.sun_path))
+        return loop->perform(fd, true, []() -> ssize_t { return -ENAMETOOLONG; });
+    std::memcpy(target.sun_path, path.c_str(), path.size() + 1);
+
+    return loop->perform(fd, true, [fd = fd, target, started = false]() mutable -> ssize_t {
+        if (!started) {
+            started = true;
+            if (::connect(fd, reinterpret_cast<const sockaddr *>(&target), sizeof(target)) == 0)
+                return 0;
+            // EAGAIN means that the listener's backlog is full, and no readiness would report it draining
+            if (errno == EAGAIN)
+                return -ECONNREFUSED;
+            return errno == EINPROGRESS ? -EAGAIN : -errno;
+        }
+
+        int error = 0;
+        socklen_t size = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0)
+            return -errno;
+        return -error;
+    });
+}
+
+AIO::TcpListener::TcpListener(
+    EpollEventLoop &loop, const sockaddr *address, const socklen_t length, const int backlog
+) : loop(loop), fd(checked(socket(address->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket")) {
+    const int reuse = 1;
+    const char *failed = nullptr;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0)
+        failed = "setsockopt";
+    else if (bind(fd, address, length) != 0)
+        failed = "bind";
+    else if (listen(fd, backlog) != 0)
+        failed = "listen";
+
+    if (failed) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), failed);
+    }
+}
+
+AIO::Future<std::expected<AIO::TcpStream, int>> AIO::TcpListener::accept() {
+    return loop.perform(fd, false, [fd = fd]() -> ssize_t {
+        return result_of(accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+    }, [loop = &loop](const ssize_t accepted) -> std::expected<TcpStream, int> {
+        if (accepted < 0)
+            return std::unexpected(static_cast<int>(-accepted));
+        return TcpStream(*loop, static_cast<int>(accepted));
+    });
+}
+
+std::uint16_t AIO::TcpListener::get_port() const {
+    sockaddr_storage address { };
+    socklen_t length = sizeof(address);
+    if (getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+        return 0;
+    if (address.ss_family == AF_INET6)
+        return ntohs(reinterpret_cast<const sockaddr_in6 *>(&address)->sin6_port);
+    return ntohs(reinterpret_cast<const sockaddr_in *>(&address)->sin_port);
+}
+
+int AIO::TcpListener::get_fd() const {
+    return fd;
+}
+
+AIO::TcpListener::~TcpListener() {
+    loop.forget(fd);
+    ::close(fd);
+}
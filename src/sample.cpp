@@ -1,8 +1,24 @@
+#include "aio.hpp"
 #include "context.hpp"
 #include "coroutine.hpp"
+#include "epoll.hpp"
+#include "file.hpp"
+#include "net.hpp"
+#include "pipeline.hpp"
+#include "sharded.hpp"
+#include "uring.hpp"
+#include "work_stealing.hpp"
 
 #include <memory>
 #include <iostream>
+#include <numeric>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 void sample_contexts() {
     std::cout << "-----------Contexts-----------" << std::endl;
@@ -65,9 +81,319 @@ void sample_coroutines() {
         std::cout << e << ' ';
     }
     std::cout << std::endl;
+
+    // A generator of std::optional ends by returning std::nullopt, without an exception
+    AIO::Coroutine<std::optional<int>()> squares = [&squares]() -> std::optional<int> {
+        for (int i = 1; i <= 5; i++) {
+            squares.yield(i * i);
+        }
+        return std::nullopt;
+    };
+    std::cout << "Squares: ";
+    for (const int e : AIO::CoroutineGenerator(squares)) {
+        std::cout << e << ' ';
+    }
+    std::cout << std::endl;
+
+    // A generator of std::span hands out a whole buffer per switch, iteration reads it in place
+    AIO::Coroutine<std::span<int>()> chunks = [&chunks]() -> std::span<int> {
+        int buffer[4];
+        for (int base = 0; base < 12; base += 4) {
+            std::iota(std::begin(buffer), std::end(buffer), base);
+            chunks.yield(std::span(buffer));
+        }
+        return { };
+    };
+    std::cout << "Chunked: ";
+    for (const int e : AIO::CoroutineGenerator(chunks)) {
+        std::cout << e << ' ';
+    }
+    std::cout << std::endl;
+}
+
+void sample_pipeline() {
+    std::cout << "-----------Pipeline-----------" << std::endl;
+
+    AIO::Coroutine<std::optional<int>()> naturals = [&naturals] [[noreturn]] () -> std::optional<int> {
+        for (int i = 1;; i++) {
+            naturals.yield(i);
+        }
+    };
+    const std::vector<std::string> names = { "one", "two", "three" };
+
+    // Only the generator has a stack, the stages run in this loop
+    auto odd_squares = naturals
+        | AIO::views::filter([](const int e) { return e % 2 == 1; })
+        | AIO::views::map([](const int e) { return e * e; });
+    for (auto [name, square] : AIO::views::zip(names, odd_squares)) {
+        std::cout << name << ": " << square << std::endl;
+    }
+
+    for (const auto &chunk : naturals | AIO::views::take(7) | AIO::views::chunk(3)) {
+        std::cout << "Chunk of " << chunk.size() << ": ";
+        for (const int e : chunk) {
+            std::cout << e << ' ';
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "Letters: ";
+    for (const char c : names | AIO::views::flat_map([](const std::string &name) -> const std::string & {
+        return name;
+    })) {
+        std::cout << c;
+    }
+    std::cout << std::endl;
+}
+
+void sample_symmetric_transfer() {
+    std::cout << "------Symmetric transfer------" << std::endl;
+
+    // Ping and pong hand control to each other directly, main only sees ping finish
+    AIO::Coroutine<void(int)> *pong_ptr = nullptr;
+    AIO::Coroutine<void(int)> ping = [&ping, &pong_ptr](int n) {
+        while (n < 5) {
+            std::cout << "ping " << n << std::endl;
+            n = ping.transfer(*pong_ptr, n + 1);
+        }
+    };
+    AIO::Coroutine<void(int)> pong = [&pong, &ping] [[noreturn]] (int n) {
+        while (true) {
+            std::cout << "pong " << n << std::endl;
+            n = pong.transfer(ping, n + 1);
+        }
+    };
+    pong_ptr = &pong;
+
+    ping.resume(1);
+    std::cout << "Back in main, ping is " << (ping.is_dead() ? "finished" : "suspended") << std::endl;
+}
+
+void sample_event_loop() {
+    std::cout << "----------Event loop----------" << std::endl;
+
+    AIO::SynchronousEventLoop::create_and_run([](AIO::EventLoop &loop) {
+        auto square = loop.async([&loop](const int x) -> int {
+            loop.sleep(std::chrono::milliseconds(10)).await();
+            return x * x;
+        });
+
+        auto first = square(3);
+        auto second = square(4);
+        std::cout << "3^2 + 4^2 = " << first.await() + second.await() << std::endl;
+
+        // A function that never awaits can run without a stack of its own
+        auto chained = loop.async_call(AIO::NEVER_AWAITS, [] { return 2; }).then(square);
+        std::cout << "2^2 = " << chained.await() << std::endl;
+    });
+}
+
+void sample_posting() {
+    std::cout << "-----------Posting------------" << std::endl;
+
+    AIO::SynchronousEventLoop worker;
+    std::thread thread([&worker] {
+        worker.run_until_stopped();
+    });
+
+    AIO::SynchronousEventLoop::create_and_run([&worker](AIO::EventLoop &) {
+        // Runs on the worker thread, the result comes back to this loop
+        auto sum = worker.post_future([] {
+            int result = 0;
+            for (int i = 1; i <= 100; i++) {
+                result += i;
+            }
+            return result;
+        });
+        std::cout << "1 + ... + 100 = " << sum.await() << " computed on another thread" << std::endl;
+    });
+
+    worker.stop();
+    thread.join();
+}
+
+void sample_blocking() {
+    std::cout << "-----------Blocking-----------" << std::endl;
+
+    AIO::SynchronousEventLoop::create_and_run([](AIO::EventLoop &loop) {
+        auto slow = loop.run_blocking([] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            return 42;
+        });
+
+        // The loop keeps running other coroutines while the pool thread sleeps
+        auto ticks = loop.async_call([&loop] {
+            int count = 0;
+            for (; count < 3; count++) {
+                loop.sleep(std::chrono::milliseconds(1)).await();
+            }
+            return count;
+        });
+        std::cout << "Ticked " << ticks.await() << " times while waiting" << std::endl;
+        std::cout << "Blocking call returned " << slow.await() << std::endl;
+    });
+}
+
+void sample_files() {
+    std::cout << "------------Files-------------" << std::endl;
+
+    char path[] = "/tmp/aio-sample-XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+        return;
+    constexpr char text[] = "first line\nsecond line\nthird line\n";
+    [[maybe_unused]] const auto written = write(fd, text, sizeof(text) - 1);
+    close(fd);
+
+    // Small chunks, so that the lines span several of them
+    auto chunked = AIO::read_file(path, 8);
+    std::size_t lines = 0;
+    for (const std::byte byte : AIO::CoroutineGenerator(chunked)) {
+        lines += byte == std::byte('\n');
+    }
+    std::cout << "Read lines: " << lines << std::endl;
+
+    auto mapped = AIO::map_file(path, 8);
+    std::size_t chunks = 0;
+    while (!mapped.resume().empty()) {
+        chunks++;
+    }
+    std::cout << "Mapped chunks: " << chunks << std::endl;
+
+    AIO::SynchronousEventLoop::create_and_run([&path](AIO::EventLoop &loop) {
+        // The next chunk is read on the blocking pool while this one is counted
+        AIO::AsyncFileReader reader(loop, path, 8);
+        std::size_t bytes = 0;
+        for (auto chunk = reader.next().await(); !chunk.empty(); chunk = reader.next().await()) {
+            bytes += chunk.size();
+        }
+        std::cout << "Read asynchronously: " << bytes << " bytes" << std::endl;
+    });
+
+    unlink(path);
+}
+
+void sample_epoll() {
+    std::cout << "------------Epoll-------------" << std::endl;
+
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
+        return;
+
+    AIO::EpollEventLoop::create_and_run([&fds](AIO::EpollEventLoop &loop) {
+        auto writer = loop.async_call([&loop, &fds] {
+            loop.sleep(std::chrono::milliseconds(10)).await();
+            constexpr char message[] = "Hello through a pipe";
+            return write(fds[1], message, sizeof(message));
+        });
+
+        char buffer[64];
+        ssize_t received;
+        while ((received = read(fds[0], buffer, sizeof(buffer))) < 0 && errno == EAGAIN) {
+            std::cout << "Waiting for the pipe to become readable" << std::endl;
+            loop.readable(fds[0]).await();
+        }
+        std::cout << "Received: " << buffer << std::endl;
+
+        writer.await();
+        loop.forget(fds[0]);
+    });
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void sample_sockets() {
+    std::cout << "-----------Sockets------------" << std::endl;
+
+    AIO::EpollEventLoop::create_and_run([](AIO::EpollEventLoop &loop) {
+        auto [left, right] = AIO::UnixStream::pair(loop);
+
+        // The reader waits for all of the message, which the writer sends from two buffers at once
+        char received[13] = { };
+        auto reader = right.read_exact(std::as_writable_bytes(std::span(received)));
+
+        char hello[] = "Hello, ";
+        char world[] = "world";
+        const iovec parts[] = { { hello, 7 }, { world, sizeof(world) } };
+        std::cout << "Sent " << left.writev(parts).await() << " bytes" << std::endl;
+        std::cout << "Received " << reader.await() << " bytes: " << received << std::endl;
+    });
+}
+
+void sample_uring() {
+    std::cout << "-----------io_uring-----------" << std::endl;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0)
+        return;
+
+    AIO::UringEventLoop::create_and_run([&fds](AIO::UringEventLoop &loop) {
+        char buffer[64] = { };
+        auto reader = loop.read(fds[0], buffer, sizeof(buffer));
+
+        std::cout << "Timeout result: " << loop.timeout(std::chrono::milliseconds(10)).await() << std::endl;
+
+        constexpr char message[] = "Hello through io_uring";
+        auto writer = loop.write(fds[1], message, sizeof(message));
+
+        std::cout << "Written: " << writer.await() << " bytes" << std::endl;
+        std::cout << "Read: " << reader.await() << " bytes: " << buffer << std::endl;
+    });
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void sample_work_stealing() {
+    std::cout << "--------Work stealing---------" << std::endl;
+
+    AIO::WorkStealingEventLoop::create_and_run([](AIO::EventLoop &loop) {
+        auto square = loop.async([&loop](const int x) -> int {
+            loop.sleep(std::chrono::milliseconds(1)).await();
+            return x * x;
+        });
+
+        // Futures are moved into place before the first await, after that their producers run on other workers
+        std::vector<AIO::Future<int>> squares;
+        squares.reserve(100);
+        for (int i = 1; i <= 100; i++) {
+            squares.push_back(square(i));
+        }
+
+        int sum = 0;
+        for (auto &future : squares) {
+            sum += future.await();
+        }
+        std::cout << "1^2 + ... + 100^2 = " << sum << std::endl;
+    }, 4);
+}
+
+void sample_sharded() {
+    std::cout << "------------Shards------------" << std::endl;
+
+    AIO::ShardedEventLoop::create_and_run([](AIO::ShardedEventLoop &loop) {
+        auto remote = loop.submit_to(1, [&loop](AIO::EventLoop &shard) -> std::size_t {
+            shard.sleep(std::chrono::milliseconds(1)).await();
+            return loop.current_shard();
+        });
+        const std::size_t ran_on = remote.await();
+        std::cout << "Ran on shard " << ran_on << ", resumed on shard " << loop.current_shard() << std::endl;
+    }, 2);
 }
 
 int main() {
     sample_contexts();
     sample_coroutines();
+    sample_pipeline();
+    sample_symmetric_transfer();
+    sample_event_loop();
+    sample_posting();
+    sample_blocking();
+    sample_files();
+    sample_epoll();
+    sample_sockets();
+    sample_uring();
+    sample_work_stealing();
+    sample_sharded();
 }
@@ -0,0 +1,275 @@
+#include "sharded.hpp"
+
+#include <algorithm>
+#include <latch>
+#include <system_error>
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+
+thread_local AIO::ShardedEventLoop::Shard *AIO::ShardedEventLoop::current = nullptr;
+
+AIO::ShardedEventLoop::ShardedEventLoop(std::size_t shards, const bool pin) : pin(pin) {
+    if (shards == 0)
+        shards = 1;
+
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        throw std::system_error(errno, std::generic_category(), "sched_getaffinity");
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set))
+            cpus.push_back(cpu);
+    }
+
+    for (std::size_t i = 0; i < shards; i++) {
+        this->shards.push_back(std::make_unique<Shard>(*this, i, shards, cpus[i % cpus.size()]));
+    }
+}
+
+AIO::EventLoop &AIO::ShardedEventLoop::shard(const std::size_t index) {
+    return *shards.at(index);
+}
+
+std::size_t AIO::ShardedEventLoop::get_shard_count() const {
+    return shards.size();
+}
+
+std::size_t AIO::ShardedEventLoop::current_shard() const {
+    return local_shard().get_index();
+}
+
+void AIO::ShardedEventLoop::run() {
+    active.store(shards.size());
+    stopping.store(false);
+    running.store(true);
+
+    // Threads wait for the latch, so that a failure to pin one of them stops all before any shard has run a task
+    std::latch start(1);
+    int error = 0;
+    {
+        std::vector<std::jthread> threads;
+        try {
+            for (const auto &shard : shards) {
+                threads.emplace_back([&shard, &start, &error]() -> void {
+                    start.wait();
+                    if (error == 0)
+                        shard->work();
+                });
+                if (pin && error == 0)
+                    error = shard->pin(threads.back());
+            }
+        } catch (...) {
+            error = -1;
+            start.count_down();
+            running.store(false);
+            throw;
+        }
+        start.count_down();
+    }
+    running.store(false);
+
+    if (error != 0)
+        throw std::system_error(error, std::generic_category(), "pthread_setaffinity_np");
+}
+
+AIO::ShardedEventLoop::Shard &AIO::ShardedEventLoop::local_shard() const {
+    if (!current || current->get_index() >= shards.size() || shards[current->get_index()].get() != current)
+        assertion_failed("not on a shard of this loop");
+    return *current;
+}
+
+void AIO::ShardedEventLoop::stop() {
+    stopping.store(true);
+    for (const auto &shard : shards) {
+        shard->wake();
+    }
+}
+
+AIO::ShardedEventLoop::Shard::Shard(
+    ShardedEventLoop &owner, const std::size_t index, const std::size_t count, const int cpu
+) : owner(owner), index(index), cpu(cpu), overflow(count) {
+    for (std::size_t i = 0; i < count; i++) {
+        inbox.push_back(std::make_unique<_impl::SpscRing<Task>>());
+    }
+}
+
+int AIO::ShardedEventLoop::Shard::pin(std::jthread &thread) const {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+}
+
+void AIO::ShardedEventLoop::Shard::work() {
+    current = this;
+    busy = true;
+
+    while (true) {
+        receive();
+        flush();
+        tasks.collect(Clock::now());
+        tasks.run_ready();
+        if (tasks.has_ready())
+            continue;
+
+        if (busy && tasks.empty()) {
+            busy = false;
+            if (owner.active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                owner.stop();
+        }
+
+        wait();
+        if (owner.stopping.load())
+            break;
+    }
+
+    current = nullptr;
+}
+
+void AIO::ShardedEventLoop::Shard::wake() {
+    remote.wake();
+}
+
+std::size_t AIO::ShardedEventLoop::Shard::get_index() const {
+    return index;
+}
+
+AIO::StackAllocator &AIO::ShardedEventLoop::Shard::get_stack_allocator() {
+    return stacks;
+}
+
+void AIO::ShardedEventLoop::Shard::set_current_coroutine(FutureCoroutine *cor) {
+    cur = cor;
+}
+
+AIO::EventLoop::FutureCoroutine *AIO::ShardedEventLoop::Shard::get_current_coroutine() const {
+    return cur;
+}
+
+void AIO::ShardedEventLoop::Shard::add_task(std::move_only_function<void()> fn, const Clock::time_point when) {
+    check_thread();
+    tasks.schedule(std::move(fn), when);
+}
+
+void AIO::ShardedEventLoop::Shard::add_task(std::move_only_function<void()> fn) {
+    check_thread();
+    tasks.post(std::move(fn));
+}
+
+void AIO::ShardedEventLoop::Shard::add_task(_impl::TaskNode *task) {
+    check_thread();
+    tasks.post(task);
+}
+
+AIO::_impl::TaskQueue *AIO::ShardedEventLoop::Shard::get_task_queue() {
+    check_thread();
+    return &tasks;
+}
+
+void AIO::ShardedEventLoop::Shard::expect_remote_task() {
+    // Counted like a message in flight until receive() has queued the task
+    owner.active.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AIO::ShardedEventLoop::Shard::add_remote_task(std::move_only_function<void()> fn) {
+    remote.post(std::move(fn));
+}
+
+void AIO::ShardedEventLoop::Shard::check_thread() const {
+    if (current != this && owner.running.load(std::memory_order_relaxed))
+        assertion_failed("task added to a running shard from another thread");
+}
+
+void AIO::ShardedEventLoop::Shard::send(Shard &target, Task message) {
+    // Counted until the target has queued it, so that the loop cannot stop while a message is in flight
+    owner.active.fetch_add(1, std::memory_order_relaxed);
+
+    std::deque<Task> &pending = overflow[target.index];
+    if (!pending.empty() || !target.inbox[index]->try_push(std::move(message))) {
+        pending.push_back(std::move(message));
+        return;
+    }
+
+    // Either the target sees the message before it sleeps or this shard sees it sleeping
+    target.remote.notify();
+}
+
+void AIO::ShardedEventLoop::Shard::spawn(Task fn) {
+    const std::uint64_t id = next_detached++;
+    auto cor = std::make_unique<FutureCoroutine>([this, id, fn = std::move(fn)]() mutable -> void {
+        fn();
+        // Runs once the coroutine has finished and switched out
+        add_task([this, id]() -> void {
+            detached.erase(id);
+        });
+    }, stacks);
+    add_coroutine(*cor);
+    detached.emplace(id, std::move(cor));
+}
+
+void AIO::ShardedEventLoop::Shard::receive() {
+    std::size_t received = remote.drain(tasks);
+    Task message;
+    for (const auto &ring : inbox) {
+        while (ring->try_pop(message)) {
+            tasks.post(std::move(message));
+            received++;
+        }
+    }
+    if (received == 0)
+        return;
+
+    if (!busy) {
+        busy = true;
+        owner.active.fetch_add(1, std::memory_order_relaxed);
+    }
+    owner.active.fetch_sub(received, std::memory_order_acq_rel);
+}
+
+void AIO::ShardedEventLoop::Shard::flush() {
+    for (std::size_t i = 0; i < overflow.size(); i++) {
+        std::deque<Task> &pending = overflow[i];
+        if (pending.empty())
+            continue;
+
+        Shard &target = *owner.shards[i];
+        while (!pending.empty() && target.inbox[index]->try_push(std::move(pending.front()))) {
+            pending.pop_front();
+        }
+        target.remote.notify();
+    }
+}
+
+void AIO::ShardedEventLoop::Shard::wait() {
+    bool overflowing = false;
+    for (const auto &pending : overflow) {
+        overflowing |= !pending.empty();
+    }
+
+    timespec ts { };
+    const timespec *timeout = nullptr;
+    if (tasks.has_ready() || overflowing) {
+        timeout = &ts;
+    } else if (const auto deadline = tasks.next_deadline(); deadline.has_value()) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::max(*deadline - Clock::now(), Clock::duration::zero())
+        ).count();
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        timeout = &ts;
+    }
+
+    // The rings are checked after the announcement, so a sender either finds the shard sleeping or is seen here
+    const bool empty = remote.prepare_sleep() &&
+                       std::ranges::all_of(inbox, [](const auto &ring) -> bool { return ring->empty(); });
+    pollfd fd { remote.get_fd(), POLLIN, 0 };
+    if (empty && !owner.stopping.load())
+        ppoll(&fd, 1, timeout, nullptr);
+    remote.finish_sleep();
+
+    if (fd.revents & POLLIN)
+        remote.acknowledge();
+}
@@ -0,0 +1,214 @@
+#include "stack.hpp"
+#include "util.hpp"
+
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+std::size_t AIO::_impl::page_size() {
+    static const std::size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+namespace {
+
+    std::size_t round_to_pages(const std::size_t size) {
+        const std::size_t page = AIO::_impl::page_size();
+        return (size + page - 1) / page * page;
+    }
+
+}
+
+std::size_t AIO::_impl::resident_size(const void *memory, const std::size_t size) {
+    const std::size_t page = page_size();
+    const auto address = reinterpret_cast<std::uintptr_t>(memory);
+    const std::uintptr_t begin = address / page * page;
+    const std::size_t pages = (address + size - begin + page - 1) / page;
+
+    std::vector<unsigned char> residency(pages);
+    if (mincore(reinterpret_cast<void *>(begin), pages * page, residency.data()) != 0)
+        return 0;
+
+    std::size_t resident = 0;
+    for (const unsigned char flags : residency) {
+        if (flags & 1)
+            resident += page;
+    }
+    return resident;
+}
+
+void *AIO::HeapStackAllocator::allocate(const std::size_t size) {
+    return ::operator new(size, std::align_val_t(16));
+}
+
+void AIO::HeapStackAllocator::deallocate(void *stack, const std::size_t size) noexcept {
+    ::operator delete(stack, size, std::align_val_t(16));
+}
+
+AIO::HeapStackAllocator &AIO::HeapStackAllocator::instance() {
+    static HeapStackAllocator allocator;
+    return allocator;
+}
+
+void *AIO::MmapStackAllocator::allocate(const std::size_t size) {
+    const std::size_t guard = _impl::page_size();
+    const std::size_t length = round_to_pages(size) + guard;
+
+    void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (mapping == MAP_FAILED)
+        throw std::bad_alloc();
+
+    if (mprotect(mapping, guard, PROT_NONE) != 0) {
+        munmap(mapping, length);
+        throw std::bad_alloc();
+    }
+
+    return static_cast<char *>(mapping) + guard;
+}
+
+void AIO::MmapStackAllocator::deallocate(void *stack, const std::size_t size) noexcept {
+    const std::size_t guard = _impl::page_size();
+
+    munmap(static_cast<char *>(stack) - guard, round_to_pages(size) + guard);
+}
+
+AIO::MmapStackAllocator &AIO::MmapStackAllocator::instance() {
+    static MmapStackAllocator allocator;
+    return allocator;
+}
+
+AIO::ReservedStackAllocator::ReservedStackAllocator(const std::size_t reservation, const std::size_t chunk_stacks)
+    : reservation(round_to_pages(reservation)), chunk_stacks(chunk_stacks) {
+    if (chunk_stacks == 0)
+        assertion_failed("chunk must hold at least one stack");
+}
+
+void *AIO::ReservedStackAllocator::allocate(const std::size_t size) {
+    if (size > reservation)
+        assertion_failed("stack size exceeds reservation");
+
+    if (free.empty()) {
+        const std::size_t length = reservation * chunk_stacks;
+
+        void *chunk = mmap(
+            nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0
+        );
+        if (chunk == MAP_FAILED)
+            throw std::bad_alloc();
+        chunks.push_back(chunk);
+
+        free.reserve(chunks.size() * chunk_stacks); // deallocate() must never reallocate
+        for (std::size_t i = chunk_stacks; i > 0; i--) {
+            free.push_back(static_cast<char *>(chunk) + (i - 1) * reservation);
+        }
+    }
+
+    void *stack = free.back();
+    free.pop_back();
+    return stack;
+}
+
+void AIO::ReservedStackAllocator::deallocate(void *stack, std::size_t) noexcept {
+    madvise(stack, reservation, MADV_DONTNEED);
+    free.push_back(stack);
+}
+
+std::size_t AIO::ReservedStackAllocator::get_reservation() const {
+    return reservation;
+}
+
+AIO::ReservedStackAllocator::~ReservedStackAllocator() {
+    for (void *chunk : chunks) {
+        munmap(chunk, reservation * chunk_stacks);
+    }
+}
+
+AIO::StackPool::StackPool(const std::size_t stack_size, const std::size_t limit, StackAllocator &upstream)
+    : stack_size(stack_size), limit(limit), upstream(upstream) {
+    if (stack_size < sizeof(FreeNode))
+        assertion_failed("stack size is too small");
+}
+
+void *AIO::StackPool::allocate(const std::size_t size) {
+    if (size != stack_size || !head)
+        return upstream.allocate(size);
+
+    FreeNode *node = head;
+    head = node->next;
+    count--;
+    return node;
+}
+
+void AIO::StackPool::deallocate(void *stack, const std::size_t size) noexcept {
+    if (size != stack_size || count >= limit) {
+        upstream.deallocate(stack, size);
+        return;
+    }
+
+    head = new (stack) FreeNode { head };
+    count++;
+}
+
+void AIO::StackPool::reserve(std::size_t count) {
+    if (count > limit)
+        count = limit;
+
+    while (this->count < count) {
+        head = new (upstream.allocate(stack_size)) FreeNode { head };
+        this->count++;
+    }
+}
+
+void AIO::StackPool::shrink(const std::size_t count) {
+    while (this->count > count) {
+        FreeNode *node = head;
+        head = node->next;
+        this->count--;
+        upstream.deallocate(node, stack_size);
+    }
+}
+
+void AIO::StackPool::set_limit(const std::size_t limit) {
+    this->limit = limit;
+    shrink(limit);
+}
+
+std::size_t AIO::StackPool::get_limit() const {
+    return limit;
+}
+
+std::size_t AIO::StackPool::get_stack_size() const {
+    return stack_size;
+}
+
+std::size_t AIO::StackPool::cached() const {
+    return count;
+}
+
+AIO::StackPool::~StackPool() {
+    shrink();
+}
+
+AIO::StackPool &AIO::StackPool::local() {
+    static thread_local StackPool pool;
+    return pool;
+}
+
+void *AIO::LocalStackAllocator::allocate(const std::size_t size) {
+    return StackPool::local().allocate(size);
+}
+
+void AIO::LocalStackAllocator::deallocate(void *stack, const std::size_t size) noexcept {
+    StackPool::local().deallocate(stack, size);
+}
+
+AIO::LocalStackAllocator &AIO::LocalStackAllocator::instance() {
+    static LocalStackAllocator allocator;
+    return allocator;
+}
+
+AIO::StackAllocator &AIO::default_stack_allocator() {
+    return LocalStackAllocator::instance();
+}
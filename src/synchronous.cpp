@@ -0,0 +1,72 @@
+#include "aio.hpp"
+
+#include <poll.h>
+
+AIO::SynchronousEventLoop::SynchronousEventLoop(const WaitStrategy strategy) : timer(strategy) {
+}
+
+void AIO::SynchronousEventLoop::run() {
+    loop(false);
+}
+
+void AIO::SynchronousEventLoop::run_until_stopped() {
+    loop(true);
+}
+
+void AIO::SynchronousEventLoop::stop() {
+    stopping.store(true);
+    remote.wake();
+}
+
+void AIO::SynchronousEventLoop::loop(const bool until_stopped) {
+    SynchronousEventLoop *outer = running;
+    running = this;
+
+    while (!stopping.load(std::memory_order_relaxed)) {
+        remote.drain(tasks);
+        if (tasks.empty() && !remote.awaiting() && !until_stopped)
+            break;
+
+        if (!tasks.has_ready())
+            wait(tasks.next_deadline());
+        tasks.collect(Clock::now());
+        tasks.run_ready();
+    }
+
+    // A stop() only ends the run it was meant for
+    stopping.store(false);
+    running = outer;
+}
+
+void AIO::SynchronousEventLoop::wait(const std::optional<Clock::time_point> deadline) {
+    timespec ts { };
+    const timespec *timeout = nullptr;
+    if (deadline.has_value()) {
+        if (const auto duration = timer.poll_timeout(*deadline); duration.has_value()) {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(*duration).count();
+            ts.tv_sec = ns / 1000000000;
+            ts.tv_nsec = ns % 1000000000;
+            timeout = &ts;
+        }
+    }
+
+    // The timerfd is only set up by the TIMERFD strategy, poll skips the negative descriptor otherwise
+    pollfd fds[2] = { { remote.get_fd(), POLLIN, 0 }, { timer.get_fd(), POLLIN, 0 } };
+
+    int polled = -1;
+    if (remote.prepare_sleep() && !stopping.load())
+        polled = ppoll(fds, 2, timeout, nullptr);
+    remote.finish_sleep();
+
+    // SPIN has polled up to SPIN_THRESHOLD before the deadline; posted tasks end the spin like they end the poll
+    if (polled == 0 && deadline.has_value()) {
+        timer.spin_until(*deadline, [this]() -> bool {
+            return !remote.empty() || stopping.load(std::memory_order_relaxed);
+        });
+    }
+
+    if (fds[0].revents & POLLIN)
+        remote.acknowledge();
+    if (fds[1].revents & POLLIN)
+        timer.acknowledge();
+}
@@ -0,0 +1,406 @@
+#include "timer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <system_error>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+AIO::_impl::TimerWheel::TimerWheel(const std::uint64_t now) : now(now) {
+}
+
+AIO::_impl::TimerWheel::Handle AIO::_impl::TimerWheel::insert(const std::uint64_t expiry, TaskNode *task) {
+    Node *node = allocate();
+    node->expiry = expiry;
+    node->task = task;
+    link(node);
+    count++;
+    return node;
+}
+
+void AIO::_impl::TimerWheel::cancel(const Handle handle) {
+    unlink(handle);
+    count--;
+    release(handle);
+}
+
+void AIO::_impl::TimerWheel::advance(const std::uint64_t tick, TaskList &expired) {
+    while (true) {
+        const auto next = next_slot();
+        if (!next.has_value() || next->first > tick) {
+            now = std::max(now, tick);
+            return;
+        }
+
+        now = next->first;
+        Level &level = levels[next->second];
+        const unsigned slot = (now >> (SLOT_BITS * next->second)) & (SLOTS - 1);
+        Node *node = level.slots[slot];
+        level.slots[slot] = nullptr;
+        level.occupied &= ~(std::uint64_t(1) << slot);
+
+        while (node) {
+            Node *following = node->next;
+            if (node->expiry <= now) {
+                expired.push(node->task);
+                count--;
+                release(node);
+            } else {
+                link(node);
+            }
+            node = following;
+        }
+    }
+}
+
+std::optional<std::uint64_t> AIO::_impl::TimerWheel::next_event() const {
+    const auto next = next_slot();
+    if (!next.has_value())
+        return std::nullopt;
+    return next->first;
+}
+
+std::uint64_t AIO::_impl::TimerWheel::get_now() const {
+    return now;
+}
+
+std::size_t AIO::_impl::TimerWheel::size() const {
+    return count;
+}
+
+bool AIO::_impl::TimerWheel::empty() const {
+    return count == 0;
+}
+
+// Slots of a level always lie ahead of the current position within the enclosing slot of the level above, so the
+// first occupied slot of the lowest non-empty level is the next one to expire or cascade.
+std::optional<std::pair<std::uint64_t, unsigned>> AIO::_impl::TimerWheel::next_slot() const {
+    for (unsigned l = 0; l < LEVELS; l++) {
+        const unsigned shift = SLOT_BITS * l;
+        const unsigned current = (now >> shift) & (SLOTS - 1);
+
+        std::uint64_t pending = levels[l].occupied & (~std::uint64_t(0) << current);
+        if (l > 0)
+            pending &= ~(std::uint64_t(1) << current);
+        if (!pending)
+            continue;
+
+        const unsigned slot = std::countr_zero(pending);
+        const unsigned upper = shift + SLOT_BITS;
+        const std::uint64_t prefix = upper < 64 ? now & (~std::uint64_t(0) << upper) : 0;
+        return std::pair(prefix | (std::uint64_t(slot) << shift), l);
+    }
+    return std::nullopt;
+}
+
+void AIO::_impl::TimerWheel::link(Node *node) {
+    const std::uint64_t expiry = std::max(node->expiry, now);
+    const std::uint64_t diff = expiry ^ now;
+    const unsigned level = diff ? (63 - std::countl_zero(diff)) / SLOT_BITS : 0;
+    const unsigned slot = (expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+
+    node->level = level;
+    node->slot = slot;
+    node->prev = nullptr;
+    node->next = levels[level].slots[slot];
+    if (node->next)
+        node->next->prev = node;
+    levels[level].slots[slot] = node;
+    levels[level].occupied |= std::uint64_t(1) << slot;
+}
+
+void AIO::_impl::TimerWheel::unlink(Node *node) {
+    Level &level = levels[node->level];
+    if (node->prev)
+        node->prev->next = node->next;
+    else
+        level.slots[node->slot] = node->next;
+    if (node->next)
+        node->next->prev = node->prev;
+    if (!level.slots[node->slot])
+        level.occupied &= ~(std::uint64_t(1) << node->slot);
+}
+
+AIO::_impl::TimerWheel::Node *AIO::_impl::TimerWheel::allocate() {
+    if (!free)
+        return &nodes.emplace_back();
+    Node *node = free;
+    free = node->next;
+    return node;
+}
+
+void AIO::_impl::TimerWheel::release(Node *node) {
+    node->task = nullptr;
+    node->prev = nullptr;
+    node->next = free;
+    free = node;
+}
+
+AIO::_impl::TaskQueue::TaskQueue() : timers(floor_tick(Clock::now())) {
+}
+
+void AIO::_impl::TaskQueue::post(TaskNode *task) {
+    ready.push(task);
+}
+
+void AIO::_impl::TaskQueue::cancel(const Handle handle) {
+    auto *task = static_cast<StoredTask *>(handle->task);
+    timers.cancel(handle);
+    task->extract(task);
+    release(task);
+}
+
+void AIO::_impl::TaskQueue::collect(const Clock::time_point now) {
+    timers.advance(floor_tick(now), ready);
+}
+
+void AIO::_impl::TaskQueue::run_ready() {
+    const TaskNode *last = ready.back();
+    while (last) {
+        TaskNode *task = ready.pop();
+        if (task == last)
+            last = nullptr;
+        task->run(task);
+    }
+}
+
+std::move_only_function<void()> AIO::_impl::TaskQueue::take() {
+    TaskNode *task = ready.pop();
+    if (task->run != run_stored) {
+        return [task]() -> void {
+            task->run(task);
+        };
+    }
+
+    auto *stored = static_cast<StoredTask *>(task);
+    auto fn = stored->extract(stored);
+    release(stored);
+    return fn;
+}
+
+bool AIO::_impl::TaskQueue::has_ready() const {
+    return !ready.empty();
+}
+
+std::optional<AIO::Clock::time_point> AIO::_impl::TaskQueue::next_deadline() const {
+    const auto tick = timers.next_event();
+    if (!tick.has_value())
+        return std::nullopt;
+    return Clock::time_point(Tick(*tick));
+}
+
+bool AIO::_impl::TaskQueue::empty() const {
+    return ready.empty() && timers.empty();
+}
+
+AIO::_impl::TaskQueue::~TaskQueue() {
+    for (StoredTask &task : arena) {
+        if (task.extract)
+            task.extract(&task);
+    }
+}
+
+void AIO::_impl::TaskQueue::run_stored(TaskNode *task) {
+    // The function runs in place and its node is only reused once it has returned
+    auto *stored = static_cast<StoredTask *>(task);
+    stored->call(stored);
+    stored->queue->release(stored);
+}
+
+AIO::_impl::TaskQueue::StoredTask *AIO::_impl::TaskQueue::allocate() {
+    StoredTask *task;
+    if (free) {
+        task = static_cast<StoredTask *>(free);
+        free = free->next;
+    } else {
+        task = &arena.emplace_back();
+        task->queue = this;
+        task->run = run_stored;
+    }
+    return task;
+}
+
+void AIO::_impl::TaskQueue::release(StoredTask *task) {
+    task->call = nullptr;
+    task->extract = nullptr;
+    task->next = free;
+    free = task;
+}
+
+std::uint64_t AIO::_impl::TaskQueue::floor_tick(const Clock::time_point when) {
+    return std::max(std::chrono::floor<Tick>(when.time_since_epoch()).count(), Tick::rep(0));
+}
+
+std::uint64_t AIO::_impl::TaskQueue::ceil_tick(const Clock::time_point when) {
+    return std::max(std::chrono::ceil<Tick>(when.time_since_epoch()).count(), Tick::rep(0));
+}
+
+void AIO::_impl::TaskInbox::push(std::move_only_function<void()> fn) {
+    auto *node = new Node { head.load(std::memory_order_relaxed), std::move(fn) };
+    while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+std::size_t AIO::_impl::TaskInbox::drain(TaskQueue &queue) {
+    Node *node = head.exchange(nullptr, std::memory_order_acquire);
+
+    // The stack holds the newest task first
+    Node *reversed = nullptr;
+    while (node) {
+        Node *following = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = following;
+    }
+
+    std::size_t count = 0;
+    while (reversed) {
+        Node *following = reversed->next;
+        queue.post(std::move(reversed->fn));
+        delete reversed;
+        reversed = following;
+        count++;
+    }
+    return count;
+}
+
+bool AIO::_impl::TaskInbox::empty() const {
+    return head.load(std::memory_order_acquire) == nullptr;
+}
+
+AIO::_impl::TaskInbox::~TaskInbox() {
+    Node *node = head.load(std::memory_order_acquire);
+    while (node) {
+        Node *following = node->next;
+        delete node;
+        node = following;
+    }
+}
+
+AIO::_impl::RemoteTasks::RemoteTasks() : event_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (event_fd < 0)
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+}
+
+void AIO::_impl::RemoteTasks::post(std::move_only_function<void()> fn) {
+    inbox.push(std::move(fn));
+    notify();
+}
+
+void AIO::_impl::RemoteTasks::expect() {
+    awaited++;
+}
+
+void AIO::_impl::RemoteTasks::add(std::move_only_function<void()> fn) {
+    post([this, fn = std::move(fn)]() mutable -> void {
+        awaited--;
+        fn();
+    });
+}
+
+void AIO::_impl::RemoteTasks::wake() {
+    const std::uint64_t value = 1;
+    [[maybe_unused]] const auto written = write(event_fd, &value, sizeof(value));
+}
+
+void AIO::_impl::RemoteTasks::notify() {
+    // Pairs with the fence in prepare_sleep(): either the loop sees the work or this thread sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed))
+        wake();
+}
+
+std::size_t AIO::_impl::RemoteTasks::drain(TaskQueue &queue) {
+    return inbox.empty() ? 0 : inbox.drain(queue);
+}
+
+bool AIO::_impl::RemoteTasks::empty() const {
+    return inbox.empty();
+}
+
+bool AIO::_impl::RemoteTasks::awaiting() const {
+    return awaited > 0;
+}
+
+bool AIO::_impl::RemoteTasks::prepare_sleep() {
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return inbox.empty();
+}
+
+void AIO::_impl::RemoteTasks::finish_sleep() {
+    sleeping.store(false, std::memory_order_relaxed);
+}
+
+void AIO::_impl::RemoteTasks::acknowledge() {
+    std::uint64_t value;
+    [[maybe_unused]] const auto read_bytes = read(event_fd, &value, sizeof(value));
+}
+
+int AIO::_impl::RemoteTasks::get_fd() const {
+    return event_fd;
+}
+
+AIO::_impl::RemoteTasks::~RemoteTasks() {
+    close(event_fd);
+}
+
+AIO::_impl::DeadlineTimer::DeadlineTimer(const WaitStrategy strategy) : strategy(strategy) {
+    if (strategy != WaitStrategy::TIMERFD)
+        return;
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd < 0)
+        throw std::system_error(errno, std::generic_category(), "timerfd_create");
+}
+
+std::optional<AIO::Clock::duration> AIO::_impl::DeadlineTimer::poll_timeout(const Clock::time_point deadline) {
+    switch (strategy) {
+        case WaitStrategy::TIMERFD:
+            arm(deadline);
+            return std::nullopt;
+        case WaitStrategy::SPIN:
+            return std::max(deadline - Clock::now() - SPIN_THRESHOLD, Clock::duration::zero());
+        case WaitStrategy::SLEEP:
+            break;
+    }
+    return std::max(deadline - Clock::now(), Clock::duration::zero());
+}
+
+int AIO::_impl::DeadlineTimer::get_fd() const {
+    return timer_fd;
+}
+
+void AIO::_impl::DeadlineTimer::arm(const Clock::time_point deadline) {
+    if (armed == deadline)
+        return;
+
+    // A zero it_value would disarm the timer, the earliest representable deadline fires right away anyway
+    const auto ns = std::max(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count(),
+        std::chrono::nanoseconds::rep(1)
+    );
+    itimerspec spec { };
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0)
+        throw std::system_error(errno, std::generic_category(), "timerfd_settime");
+    armed = deadline;
+}
+
+void AIO::_impl::DeadlineTimer::acknowledge() {
+    std::uint64_t expirations;
+    while (read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+        if (errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "read");
+    }
+    armed.reset();
+}
+
+AIO::_impl::DeadlineTimer::~DeadlineTimer() {
+    if (timer_fd >= 0)
+        close(timer_fd);
+}
@@ -0,0 +1,395 @@
+#include "uring.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <system_error>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+    [[noreturn]] void throw_errno(const char *what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    unsigned load_acquire(unsigned *value) {
+        return std::atomic_ref(*value).load(std::memory_order_acquire);
+    }
+
+    void store_release(unsigned *value, const unsigned desired) {
+        std::atomic_ref(*value).store(desired, std::memory_order_release);
+    }
+
+}
+
+AIO::UringEventLoop::UringEventLoop(const unsigned entries, const WaitStrategy strategy)
+    : timer(strategy == WaitStrategy::TIMERFD ? WaitStrategy::SLEEP : strategy) {
+    io_uring_params params { };
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0)
+        throw_errno("io_uring_setup");
+
+    features = params.features;
+    if (!(features & IORING_FEAT_EXT_ARG)) {
+        close(ring_fd);
+        throw std::system_error(ENOSYS, std::generic_category(), "io_uring_enter with timeout is not supported");
+    }
+
+    sq_mapping_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_mapping_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (features & IORING_FEAT_SINGLE_MMAP)
+        sq_mapping_size = cq_mapping_size = std::max(sq_mapping_size, cq_mapping_size);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    sq_mapping = mmap(
+        nullptr, sq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING
+    );
+    if (sq_mapping == MAP_FAILED) {
+        close(ring_fd);
+        throw_errno("mmap");
+    }
+
+    if (features & IORING_FEAT_SINGLE_MMAP) {
+        cq_mapping = sq_mapping;
+    } else {
+        cq_mapping = mmap(
+            nullptr, cq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING
+        );
+        if (cq_mapping == MAP_FAILED) {
+            munmap(sq_mapping, sq_mapping_size);
+            close(ring_fd);
+            throw_errno("mmap");
+        }
+    }
+
+    void *sqes_mapping = mmap(
+        nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES
+    );
+    if (sqes_mapping == MAP_FAILED) {
+        if (cq_mapping != sq_mapping)
+            munmap(cq_mapping, cq_mapping_size);
+        munmap(sq_mapping, sq_mapping_size);
+        close(ring_fd);
+        throw_errno("mmap");
+    }
+    sqes = static_cast<io_uring_sqe *>(sqes_mapping);
+
+    char *sq = static_cast<char *>(sq_mapping);
+    sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_local_tail = sq_submitted = *sq_tail;
+
+    auto *sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries; i++) {
+        sq_array[i] = i; // submission entries are always used in ring order
+    }
+
+    char *cq = static_cast<char *>(cq_mapping);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+AIO::Future<int> AIO::UringEventLoop::read(const int fd, void *buf, const unsigned len, const std::uint64_t offset) {
+    const int buffer = find_buffer(buf, len);
+    auto promise = make_promise<int>();
+    auto future = make_future(promise);
+    io_uring_sqe *sqe = prepare(buffer >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, std::move(promise));
+    sqe->addr = reinterpret_cast<std::uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = offset;
+    if (buffer >= 0)
+        sqe->buf_index = buffer;
+    return future;
+}
+
+AIO::Future<int> AIO::UringEventLoop::write(
+    const int fd, const void *buf, const unsigned len, const std::uint64_t offset
+) {
+    const int buffer = find_buffer(buf, len);
+    auto promise = make_promise<int>();
+    auto future = make_future(promise);
+    io_uring_sqe *sqe = prepare(buffer >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, std::move(promise));
+    sqe->addr = reinterpret_cast<std::uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = offset;
+    if (buffer >= 0)
+        sqe->buf_index = buffer;
+    return future;
+}
+
+AIO::Future<int> AIO::UringEventLoop::accept(const int fd, sockaddr *addr, socklen_t *addrlen, const int flags) {
+    auto promise = make_promise<int>();
+    auto future = make_future(promise);
+    io_uring_sqe *sqe = prepare(IORING_OP_ACCEPT, fd, std::move(promise));
+    sqe->addr = reinterpret_cast<std::uint64_t>(addr);
+    sqe->addr2 = reinterpret_cast<std::uint64_t>(addrlen);
+    sqe->accept_flags = flags;
+    return future;
+}
+
+AIO::Future<int> AIO::UringEventLoop::connect(const int fd, const sockaddr *addr, const socklen_t addrlen) {
+    auto promise = make_promise<int>();
+    auto future = make_future(promise);
+    io_uring_sqe *sqe = prepare(IORING_OP_CONNECT, fd, std::move(promise));
+    sqe->addr = reinterpret_cast<std::uint64_t>(addr);
+    sqe->off = addrlen;
+    return future;
+}
+
+AIO::Future<int> AIO::UringEventLoop::fsync(const int fd, const bool datasync) {
+    auto promise = make_promise<int>();
+    auto future = make_future(promise);
+    io_uring_sqe *sqe = prepare(IORING_OP_FSYNC, fd, std::move(promise));
+    sqe->fsync_flags = datasync ? IORING_FSYNC_DATASYNC : 0;
+    return future;
+}
+
+AIO::Future<int> AIO::UringEventLoop::timeout(const std::chrono::nanoseconds duration) {
+    auto promise = make_promise<int>();
+    auto future = make_future(promise);
+    io_uring_sqe *sqe = prepare(IORING_OP_TIMEOUT, -1, std::move(promise));
+    __kernel_timespec &ts = operations[sqe->user_data].timeout;
+    ts.tv_sec = duration.count() / 1000000000;
+    ts.tv_nsec = duration.count() % 1000000000;
+    sqe->addr = reinterpret_cast<std::uint64_t>(&ts);
+    sqe->len = 1;
+    return future;
+}
+
+bool AIO::UringEventLoop::register_buffers(const std::span<const iovec> buffers) {
+    if (!fixed_buffers.empty()) {
+        syscall(__NR_io_uring_register, ring_fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        fixed_buffers.clear();
+    }
+
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) != 0)
+        return false;
+
+    fixed_buffers.assign(buffers.begin(), buffers.end());
+    return true;
+}
+
+bool AIO::UringEventLoop::register_files(const std::span<const int> fds) {
+    if (!fixed_files.empty()) {
+        syscall(__NR_io_uring_register, ring_fd, IORING_UNREGISTER_FILES, nullptr, 0);
+        fixed_files.clear();
+    }
+
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_FILES, fds.data(), fds.size()) != 0)
+        return false;
+
+    for (unsigned i = 0; i < fds.size(); i++) {
+        fixed_files.emplace(fds[i], i);
+    }
+    return true;
+}
+
+void AIO::UringEventLoop::run() {
+    while (true) {
+        remote.drain(tasks);
+        tasks.collect(Clock::now());
+        tasks.run_ready();
+
+        if (tasks.empty() && in_flight == 0 && !remote.awaiting())
+            break;
+
+        const auto deadline = tasks.next_deadline();
+        std::optional<Clock::duration> delay;
+        if (tasks.has_ready())
+            delay = Clock::duration::zero();
+        else if (deadline.has_value())
+            delay = timer.poll_timeout(*deadline).value();
+
+        if (remote.awaiting())
+            watch_remote();
+        // A task that arrived from another thread since the loop drained them must not wait for the timeout
+        const bool sleep = remote.prepare_sleep();
+        if (!sleep)
+            delay = Clock::duration::zero();
+
+        if (!delay.has_value()) {
+            enter(1, nullptr);
+        } else if (*delay == Clock::duration::zero()) {
+            enter(0, nullptr);
+        } else {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(*delay).count();
+            const __kernel_timespec ts { ns / 1000000000, ns % 1000000000 };
+            enter(1, &ts);
+        }
+        remote.finish_sleep();
+
+        // SPIN has waited up to SPIN_THRESHOLD before the deadline; completions and tasks from other threads end
+        // the spin like they end the wait, and the completion queue is shared memory, so it is watched for free
+        if (sleep && !tasks.has_ready() && deadline.has_value()) {
+            timer.spin_until(*deadline, [this]() -> bool {
+                return !remote.empty() || load_acquire(cq_tail) != *cq_head;
+            });
+        }
+
+        reap();
+    }
+}
+
+AIO::UringEventLoop::~UringEventLoop() {
+    munmap(sqes, sqes_size);
+    if (cq_mapping != sq_mapping)
+        munmap(cq_mapping, cq_mapping_size);
+    munmap(sq_mapping, sq_mapping_size);
+    close(ring_fd);
+}
+
+AIO::StackAllocator &AIO::UringEventLoop::get_stack_allocator() {
+    return stacks;
+}
+
+void AIO::UringEventLoop::set_current_coroutine(FutureCoroutine *cor) {
+    cur = cor;
+}
+
+AIO::EventLoop::FutureCoroutine *AIO::UringEventLoop::get_current_coroutine() const {
+    return cur;
+}
+
+void AIO::UringEventLoop::add_task(
+    std::move_only_function<void()> fn, const Clock::time_point when
+) {
+    tasks.schedule(std::move(fn), when);
+}
+
+void AIO::UringEventLoop::add_task(std::move_only_function<void()> fn) {
+    tasks.post(std::move(fn));
+}
+
+void AIO::UringEventLoop::add_task(_impl::TaskNode *task) {
+    tasks.post(task);
+}
+
+AIO::_impl::TaskQueue *AIO::UringEventLoop::get_task_queue() {
+    return &tasks;
+}
+
+void AIO::UringEventLoop::expect_remote_task() {
+    remote.expect();
+}
+
+void AIO::UringEventLoop::add_remote_task(std::move_only_function<void()> fn) {
+    remote.add(std::move(fn));
+}
+
+io_uring_sqe *AIO::UringEventLoop::next_sqe(const std::uint8_t opcode, const int fd) {
+    while (sq_local_tail - load_acquire(sq_head) == sq_entries) {
+        enter(0, nullptr); // submission queue is full, flush it early
+        reap();
+    }
+
+    io_uring_sqe *sqe = &sqes[sq_local_tail & sq_mask];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    if (const auto it = fixed_files.find(fd); it != fixed_files.end()) {
+        sqe->fd = static_cast<int>(it->second);
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+
+    sq_local_tail++;
+    return sqe;
+}
+
+io_uring_sqe *AIO::UringEventLoop::prepare(const std::uint8_t opcode, const int fd, Promise<int> promise) {
+    io_uring_sqe *sqe = next_sqe(opcode, fd);
+
+    std::size_t index;
+    if (free_operations.empty()) {
+        index = operations.size();
+        operations.emplace_back();
+    } else {
+        index = free_operations.back();
+        free_operations.pop_back();
+    }
+    sqe->user_data = index;
+
+    operations[index].promise = std::move(promise);
+
+    in_flight++;
+    return sqe;
+}
+
+void AIO::UringEventLoop::watch_remote() {
+    if (watching_remote)
+        return;
+
+    // Reading the eventfd consumes its signal, like RemoteTasks::acknowledge() would
+    io_uring_sqe *sqe = next_sqe(IORING_OP_READ, remote.get_fd());
+    sqe->addr = reinterpret_cast<std::uint64_t>(&remote_counter);
+    sqe->len = sizeof(remote_counter);
+    sqe->user_data = REMOTE_WAKEUP;
+    watching_remote = true;
+}
+
+int AIO::UringEventLoop::find_buffer(const void *buf, const unsigned len) const {
+    const auto *begin = static_cast<const char *>(buf);
+    for (std::size_t i = 0; i < fixed_buffers.size(); i++) {
+        const auto *fixed = static_cast<const char *>(fixed_buffers[i].iov_base);
+        if (begin >= fixed && begin + len <= fixed + fixed_buffers[i].iov_len)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void AIO::UringEventLoop::enter(const unsigned min_complete, const __kernel_timespec *timeout) {
+    const unsigned to_submit = sq_local_tail - sq_submitted;
+    store_release(sq_tail, sq_local_tail);
+
+    unsigned flags = 0;
+    io_uring_getevents_arg arg { };
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        arg.ts = reinterpret_cast<std::uint64_t>(timeout);
+    }
+
+    const long submitted = syscall(
+        __NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, flags ? &arg : nullptr, flags ? sizeof(arg) : 0
+    );
+    if (submitted < 0) {
+        if (errno == EINTR || errno == ETIME || errno == EAGAIN || errno == EBUSY)
+            return;
+        throw_errno("io_uring_enter");
+    }
+    sq_submitted += submitted;
+}
+
+void AIO::UringEventLoop::reap() {
+    unsigned head = *cq_head;
+    const unsigned tail = load_acquire(cq_tail);
+
+    while (head != tail) {
+        const io_uring_cqe &cqe = cqes[head & cq_mask];
+        const std::uint64_t user_data = cqe.user_data;
+        const int result = cqe.res;
+        head++;
+
+        if (user_data == REMOTE_WAKEUP) {
+            watching_remote = false;
+            continue;
+        }
+        const std::size_t index = user_data;
+
+        Operation &operation = operations[index];
+        const Promise<int> promise = std::move(*operation.promise);
+        operation.promise.reset();
+        free_operations.push_back(index);
+        in_flight--;
+
+        resolve(promise, result);
+    }
+
+    store_release(cq_head, head);
+}
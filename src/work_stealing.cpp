@@ -0,0 +1,285 @@
+#include "work_stealing.hpp"
+
+#include <algorithm>
+
+thread_local AIO::WorkStealingEventLoop::Worker *AIO::WorkStealingEventLoop::current_worker = nullptr;
+
+AIO::WorkStealingEventLoop::WorkStealingEventLoop(std::size_t workers) {
+    if (workers == 0)
+        workers = 1;
+
+    for (std::size_t i = 0; i < workers; i++) {
+        auto worker = std::make_unique<Worker>(this, i);
+        worker->random.seed(i + 1);
+        this->workers.push_back(std::move(worker));
+    }
+}
+
+void AIO::WorkStealingEventLoop::run() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = pending.load() == 0;
+        if (stopping)
+            return;
+    }
+
+    std::vector<std::jthread> threads;
+    for (std::size_t i = 1; i < workers.size(); i++) {
+        threads.emplace_back([this, i]() -> void {
+            work(*workers[i]);
+        });
+    }
+    work(*workers[0]);
+}
+
+std::size_t AIO::WorkStealingEventLoop::get_worker_count() const {
+    return workers.size();
+}
+
+AIO::StackAllocator &AIO::WorkStealingEventLoop::get_stack_allocator() {
+    return LocalStackAllocator::instance();
+}
+
+void AIO::WorkStealingEventLoop::set_current_coroutine(FutureCoroutine *cor) {
+    Worker *worker = local_worker();
+    if (!worker)
+        assertion_failed("coroutine resumed outside of a worker");
+    worker->cur = cor;
+}
+
+AIO::EventLoop::FutureCoroutine *AIO::WorkStealingEventLoop::get_current_coroutine() const {
+    const Worker *worker = local_worker();
+    return worker ? worker->cur : nullptr;
+}
+
+void AIO::WorkStealingEventLoop::add_task(std::move_only_function<void()> fn, const Clock::time_point when) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    if (Worker *worker = local_worker()) {
+        worker->spawned.push_back({ std::move(fn), when });
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    shared.schedule(std::move(fn), when);
+    wake_for_timer(when);
+}
+
+void AIO::WorkStealingEventLoop::add_task(std::move_only_function<void()> fn) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    if (Worker *worker = local_worker()) {
+        worker->spawned.push_back({ std::move(fn), std::nullopt });
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    shared.post(std::move(fn));
+    wake_for_task();
+}
+
+void AIO::WorkStealingEventLoop::expect_remote_task() {
+    pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AIO::WorkStealingEventLoop::add_remote_task(std::move_only_function<void()> fn) {
+    // The task is counted before the announcement is released, so that the loop cannot stop in between
+    add_task(std::move(fn));
+    finish_task();
+}
+
+void AIO::WorkStealingEventLoop::suspend(FutureCoroutine *cor, _impl::Rendezvous &rendezvous, _impl::TaskNode &wake) {
+    Worker *worker = local_worker();
+    if (!worker)
+        assertion_failed("await() outside of a worker");
+
+    // The worker parks the rendezvous once cor has switched out, nothing may touch it here after the yield
+    worker->parking = Parking { &rendezvous, &wake };
+    cor->yield();
+}
+
+void AIO::WorkStealingEventLoop::defer(std::move_only_function<void()> fn) {
+    if (Worker *worker = local_worker())
+        worker->deferred.push_back(std::move(fn));
+    else
+        fn();
+}
+
+AIO::WorkStealingEventLoop::Worker *AIO::WorkStealingEventLoop::local_worker() const {
+    return current_worker && current_worker->loop == this ? current_worker : nullptr;
+}
+
+void AIO::WorkStealingEventLoop::work(Worker &worker) {
+    current_worker = &worker;
+
+    while (true) {
+        Slot *slot = worker.deque.pop();
+        if (!slot)
+            slot = steal(worker);
+        if (slot) {
+            execute(worker, release(worker, slot));
+            continue;
+        }
+
+        std::unique_lock lock(mutex);
+        shared.collect(Clock::now());
+        if (shared.has_ready()) {
+            Task fn = shared.take();
+            if (shared.has_ready())
+                wake_for_task();
+            lock.unlock();
+            execute(worker, std::move(fn));
+            continue;
+        }
+        if (stopping)
+            break;
+
+        // Pairs with the fence in publish(): either the deques are seen non-empty here, or the publisher sees
+        // this worker idle and notifies it under the mutex, which is only released once the worker waits
+        idle.fetch_add(1);
+        if (!any_stealable()) {
+            const auto deadline = shared.next_deadline();
+            if (deadline.has_value() && !timekeeper_deadline.has_value()) {
+                timekeeper_deadline = deadline;
+                timekeeper_wakeup.wait_until(lock, *deadline);
+                timekeeper_deadline.reset();
+            } else {
+                wakeup.wait(lock);
+            }
+        }
+        idle.fetch_sub(1);
+    }
+
+    current_worker = nullptr;
+}
+
+void AIO::WorkStealingEventLoop::execute(Worker &worker, Task task) {
+    task();
+    task = nullptr;
+
+    if (worker.parking.has_value()) {
+        const Parking parking = *worker.parking;
+        worker.parking.reset();
+        if (!parking.rendezvous->park())
+            add_task(parking.wake);
+    }
+
+    for (std::size_t i = 0; i < worker.deferred.size(); i++) {
+        worker.deferred[i]();
+    }
+    worker.deferred.clear();
+
+    publish(worker);
+    finish_task();
+}
+
+void AIO::WorkStealingEventLoop::publish(Worker &worker) {
+    bool ready = false;
+    bool timed = false;
+    for (Spawned &spawned : worker.spawned) {
+        if (spawned.when.has_value()) {
+            timed = true;
+        } else {
+            worker.deque.push(acquire(worker, std::move(spawned.task)));
+            ready = true;
+        }
+    }
+
+    if (timed) {
+        std::lock_guard lock(mutex);
+        for (Spawned &spawned : worker.spawned) {
+            if (spawned.when.has_value()) {
+                shared.schedule(std::move(spawned.task), *spawned.when);
+                wake_for_timer(*spawned.when);
+            }
+        }
+    }
+    worker.spawned.clear();
+
+    if (ready) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (idle.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard lock(mutex);
+            wake_for_task();
+        }
+    }
+}
+
+AIO::WorkStealingEventLoop::Slot *AIO::WorkStealingEventLoop::steal(Worker &thief) {
+    const std::size_t count = workers.size();
+    if (count == 1)
+        return nullptr;
+
+    const std::size_t start = thief.random() % count;
+    for (std::size_t i = 0; i < count; i++) {
+        Worker &victim = *workers[(start + i) % count];
+        if (&victim == &thief)
+            continue;
+        if (Slot *slot = victim.deque.steal())
+            return slot;
+    }
+    return nullptr;
+}
+
+AIO::WorkStealingEventLoop::Slot *AIO::WorkStealingEventLoop::acquire(Worker &worker, Task task) {
+    if (!worker.free)
+        worker.free = worker.returned.exchange(nullptr, std::memory_order_acquire);
+
+    Slot *slot = worker.free;
+    if (slot)
+        worker.free = slot->next;
+    else
+        slot = &worker.slots.emplace_back(Task(), &worker);
+    slot->task = std::move(task);
+    return slot;
+}
+
+AIO::WorkStealingEventLoop::Task AIO::WorkStealingEventLoop::release(Worker &worker, Slot *slot) {
+    Task task = std::move(slot->task);
+    slot->task = nullptr;
+    Worker &home = *slot->home;
+    if (&home == &worker) {
+        slot->next = worker.free;
+        worker.free = slot;
+        return task;
+    }
+
+    // Pairs with the exchange in acquire(), which hands the whole stack to the home worker
+    slot->next = home.returned.load(std::memory_order_relaxed);
+    while (!home.returned.compare_exchange_weak(
+        slot->next, slot, std::memory_order_release, std::memory_order_relaxed
+    )) {
+    }
+    return task;
+}
+
+bool AIO::WorkStealingEventLoop::any_stealable() const {
+    return std::ranges::any_of(workers, [](const auto &worker) -> bool {
+        return !worker->deque.empty();
+    });
+}
+
+void AIO::WorkStealingEventLoop::finish_task() {
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    std::lock_guard lock(mutex);
+    stopping = true;
+    wakeup.notify_all();
+    timekeeper_wakeup.notify_all();
+}
+
+void AIO::WorkStealingEventLoop::wake_for_task() {
+    // The timekeeper has to be disturbed only when it is the sole idle worker
+    if (idle.load() > (timekeeper_deadline.has_value() ? 1 : 0))
+        wakeup.notify_one();
+    else if (timekeeper_deadline.has_value())
+        timekeeper_wakeup.notify_one();
+}
+
+void AIO::WorkStealingEventLoop::wake_for_timer(const Clock::time_point when) {
+    if (timekeeper_deadline.has_value()) {
+        if (when < *timekeeper_deadline)
+            timekeeper_wakeup.notify_one();
+    } else if (idle.load() > 0) {
+        wakeup.notify_one();
+    }
+}